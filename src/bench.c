@@ -0,0 +1,245 @@
+// tracing would dominate the measurement, only errors are logged unless the build asks for more
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/stat.h>
+
+#include "tls_client.h"
+
+inline static double per_second( double value, double elapsed_s )
+{
+    return elapsed_s > 0.0 ? value / elapsed_s : 0.0;
+}
+
+inline static void print_allocator( const char* mode, const ConnStats_t* stats )
+{
+    const AllocStats_t* alloc = &stats->allocator;
+
+    printf( "allocator    %s, %llu allocations, %.1f per handshake, %llu reached malloc, %.1f per handshake\n"
+        , mode
+        , alloc->allocations, stats->handshakes ? ( double ) alloc->allocations / stats->handshakes : 0.0
+        , alloc->system, stats->handshakes ? ( double ) alloc->system / stats->handshakes : 0.0 );
+}
+
+/**
+ * \brief   baseline is the same workload on the system allocator, it is
+ *          only there when the report compares it with -A
+ */
+inline static void print_report( const ClientOptions_t* options, const ClientResult_t* result, const ClientResult_t* baseline )
+{
+    const ConnStats_t* stats    = &result->stats;
+    const double elapsed_s      = result->elapsed_s;
+    const double bytes          = ( double ) ( stats->bytes_sent + stats->bytes_received );
+
+    printf( "connections  %d on %d workers, %d failed, %lu timed out, %.3f s\n"
+        , options->connections, options->threads, result->failed, stats->timeouts, elapsed_s );
+    printf( "handshakes   %lu, %.1f/s\n", stats->handshakes, per_second( stats->handshakes, elapsed_s ) );
+    printf( "requests     %lu, %.1f/s\n", stats->requests, per_second( stats->requests, elapsed_s ) );
+    printf( "cipher       %s\n", stats->cipher != 0 ? stats->cipher : "none negotiated" );
+    printf( "bytes        sent %llu, received %llu, %.3f MB/s\n"
+        , stats->bytes_sent, stats->bytes_received, per_second( bytes, elapsed_s ) / ( 1024.0 * 1024.0 ) );
+
+    if( baseline != 0 ) { print_allocator( "system", &baseline->stats ); }
+
+    print_allocator( options->pooled_allocator ? "arena+pools" : "system", stats );
+
+    if( options->io_uring )
+    {
+        printf( "transport    io_uring, %llu completions in %llu waits, %.1f per syscall\n"
+            , stats->io_completions, stats->io_waits, stats->io_waits ? ( double ) stats->io_completions / stats->io_waits : 0.0 );
+    }
+    else
+    {
+        printf( "sends        %llu records in %llu syscalls, %lld saved\n"
+            , stats->sends.calls, stats->sends.syscalls, ( long long ) ( stats->sends.calls - stats->sends.syscalls ) );
+    }
+
+    if( options->verify != 0 )
+    {
+        printf( "trust        %s, loaded in %llu us\n", options->verify, ( unsigned long long ) result->trust_load_us );
+    }
+
+    if( options->crypto_threads > 0 )
+    {
+        printf( "crypto       %llu handshake steps on %d threads\n", stats->crypto_jobs, options->crypto_threads );
+    }
+
+    conn_stats_print_latency( stats );
+
+    if( options->resumption ) { session_cache_print_stats( &result->session_cache ); }
+}
+
+/**
+ * \brief   Streams the body file once over a single connection with only the
+ *          given suite offered, the head announcing it is built here so the
+ *          request file of the workload stays untouched
+ * \return  upload throughput in MB/s, <0 if the transfer failed
+ */
+inline static double run_bulk_transfer( const ClientOptions_t* options, const char* suite )
+{
+    struct stat st;
+    if( stat( options->body_file, &st ) < 0 ) { return -1.0; }
+
+    char head[ 256 ];
+    int head_size = snprintf( head, sizeof( head )
+        , "POST / HTTP/1.1\r\nHost: %s\r\nContent-Length: %lld\r\n\r\n", options->server_ip, ( long long ) st.st_size );
+
+    ClientOptions_t bulk_options        = *options;
+    ClientResult_t  result;
+
+    bulk_options.cipher_list            = suite;
+    bulk_options.connections            = 1;
+    bulk_options.threads                = 1;
+    bulk_options.reconnects             = 0;
+    bulk_options.keep_alive_requests    = 1;
+    bulk_options.pipeline_depth         = 1;
+    bulk_options.resumption             = 0;
+    bulk_options.request_data           = head;
+    bulk_options.request_size           = ( size_t ) head_size;
+
+    client_run( &bulk_options, &result );
+    session_cache_free( &result.session_cache );
+
+    if( result.failed ) { return -1.0; }
+
+    return per_second( ( double ) result.stats.bytes_sent, result.elapsed_s ) / ( 1024.0 * 1024.0 );
+}
+
+/**
+ * \brief   Runs the whole workload once per cipher suite, the suites are the
+ *          ones of -L or every suite CyaSSL was built with, every handshake
+ *          is a full one, a single probe connection first tells the suites
+ *          the server cannot negotiate, e.g. ECDSA ones against an RSA
+ *          certificate, those are only listed, with -b the body file is
+ *          streamed once per suite for the bulk throughput
+ * \return  number of suites with failed connections, <0 if no suite could
+ *          be negotiated
+ */
+inline static int run_cipher_matrix( const ClientOptions_t* options )
+{
+    char suites[ 4096 ] = { '\0' };
+
+    if( options->cipher_list != 0 )
+    {
+        snprintf( suites, sizeof( suites ), "%s", options->cipher_list );
+    }
+    else if( CyaSSL_get_ciphers( suites, ( int ) sizeof( suites ) ) != SSL_SUCCESS )
+    {
+        return -1;
+    }
+
+    printf( "%-40s %-40s %12s %14s %14s %10s %7s\n"
+        , "suite", "negotiated", "handshakes/s", "handshake mean", "handshake p99", "bulk MB/s", "failed" );
+
+    int failed_suites       = 0;
+    int negotiated_suites   = 0;
+    char* saveptr           = 0;
+
+    for( char* suite = strtok_r( suites, ":", &saveptr ); suite != 0; suite = strtok_r( 0, ":", &saveptr ) )
+    {
+        ClientOptions_t suite_options   = *options;
+        ClientResult_t  result;
+
+        // resumed handshakes would hide the key exchange that is compared,
+        // the body goes to the bulk transfer only
+        suite_options.cipher_list   = suite;
+        suite_options.resumption    = 0;
+        suite_options.body_file     = 0;
+
+        ClientOptions_t probe_options       = suite_options;
+        probe_options.connections           = 1;
+        probe_options.threads               = 1;
+        probe_options.reconnects            = 0;
+        probe_options.keep_alive_requests   = 1;
+        probe_options.pipeline_depth        = 1;
+
+        client_run( &probe_options, &result );
+        session_cache_free( &result.session_cache );
+
+        if( result.stats.handshakes == 0 )
+        {
+            printf( "%-40s %s\n", suite, "unsupported by the server" );
+            fflush( stdout );
+            continue;
+        }
+
+        ++negotiated_suites;
+
+        client_run( &suite_options, &result );
+
+        const ConnStats_t* stats    = &result.stats;
+        const Histogram_t* hs       = &stats->phases.histograms[ PHASE_HANDSHAKE ];
+        const double bulk           = options->body_file != 0 ? run_bulk_transfer( options, suite ) : 0.0;
+        char bulk_text[ 32 ]        = "-";
+
+        if( options->body_file != 0 && bulk < 0.0 )  { snprintf( bulk_text, sizeof( bulk_text ), "failed" ); }
+        else if( options->body_file != 0 )          { snprintf( bulk_text, sizeof( bulk_text ), "%.3f", bulk ); }
+
+        printf( "%-40s %-40s %12.1f %11.3f ms %11.3f ms %10s %7d\n"
+            , suite
+            , stats->cipher != 0 ? stats->cipher : "-"
+            , per_second( stats->handshakes, result.elapsed_s )
+            , hs->total ? hs->sum / hs->total / 1000.0 : 0.0
+            , histogram_percentile( hs, 99.0 ) / 1000.0
+            , bulk_text
+            , result.failed );
+        fflush( stdout );
+
+        if( result.failed || bulk < 0.0 ) { ++failed_suites; }
+
+        session_cache_free( &result.session_cache );
+    }
+
+    return negotiated_suites > 0 ? failed_suites : -1;
+}
+
+/**
+ * \main
+ */
+int main( const int argc, char* const* argv )
+{
+    debug_init();
+
+    ClientOptions_t options;
+    ClientResult_t  result;
+
+    if( client_options_parse( &options, argc, argv ) < 0 )
+    {
+        client_print_usage( "bench" );
+        printf( "Point it at a loopback server (e.g. 127.0.0.1) to measure without a network.\n" );
+        exit( 1 );
+    }
+
+    if( options.cipher_matrix )
+    {
+        int failed_suites = run_cipher_matrix( &options );
+        if( failed_suites < 0 ) { error_log( "No cipher suite could be negotiated" ); }
+
+        return failed_suites != 0 ? -1 : 0;
+    }
+
+    // with -A the same workload runs on the system allocator first, so the
+    // report has the allocations per handshake before and after
+    ClientResult_t baseline;
+
+    if( options.pooled_allocator )
+    {
+        ClientOptions_t system_options  = options;
+        system_options.pooled_allocator = 0;
+
+        client_run( &system_options, &baseline );
+        session_cache_free( &baseline.session_cache );
+    }
+
+    client_run( &options, &result );
+
+    print_report( &options, &result, options.pooled_allocator ? &baseline : 0 );
+
+    session_cache_free( &result.session_cache );
+
+    return result.failed ? -1 : 0;
+}
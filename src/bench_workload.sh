@@ -0,0 +1,34 @@
+#!/bin/sh
+# Loopback workload that trains and measures the PGO build: bin/server is
+# started on PORT and bin/bench runs a handshake heavy and a transfer heavy
+# pass against it, every pass prints "<pass> <metric> <value>" lines
+set -e
+
+cd "$(dirname "$0")"
+
+PORT=${PORT:-4433}
+CONNECTIONS=${CONNECTIONS:-64}
+
+[ -f test-certs/test_cert.pem ] || make -s test-certs >/dev/null
+
+./bin/server -t 1 -s 16384 "$PORT" test-certs/test_cert.pem test-certs/test_cert >/dev/null &
+server=$!
+trap 'kill -INT $server; wait $server' EXIT
+
+# the server says it is listening only once the socket is bound
+sleep 0.5
+
+run_pass()
+{
+    name="$1"
+    shift
+
+    ./bin/bench "$@" 127.0.0.1 "$PORT" test-cases/xively.t | awk -v pass="$name" '
+        $1 == "handshakes"  { sub( "/s", "", $3 ); print pass, "handshakes/s", $3 }
+        $1 == "requests"    { sub( "/s", "", $3 ); print pass, "requests/s", $3 }
+        $1 == "bytes"       { print pass, "MB/s", $(NF - 1) }
+    '
+}
+
+run_pass handshake -c "$CONNECTIONS" -r 20 -R
+run_pass transfer -c "$CONNECTIONS" -k 200
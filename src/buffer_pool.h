@@ -0,0 +1,96 @@
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// plaintext of one full TLS record, a single CyaSSL_read or CyaSSL_write
+// on a slab moves a whole record
+#define BUFFER_POOL_SLAB_SIZE   16384
+
+/**
+ * \struct BufferSlab_t
+ * \brief  Free slabs are chained through their own first bytes
+ */
+typedef struct buffer_slab
+{
+    struct buffer_slab* next;
+} BufferSlab_t;
+
+/**
+ * \struct BufferPool_t
+ * \brief  Free list of record-sized slabs, one pool per worker so borrowing
+ *          and returning need no locking, slabs are only allocated when
+ *          more of them are in use at once than ever before
+ */
+typedef struct
+{
+    BufferSlab_t*   free_slabs;
+    unsigned long   allocated;
+    unsigned long   in_use;
+    unsigned long   peak_in_use;
+} BufferPool_t;
+
+inline static void buffer_pool_init( BufferPool_t* pool )
+{
+    assert( pool != 0 && "Pool must not be null!" );
+
+    memset( pool, 0, sizeof( BufferPool_t ) );
+}
+
+/**
+ * \return  slab of BUFFER_POOL_SLAB_SIZE bytes if successfull 0 other way
+ */
+inline static char* buffer_pool_borrow( BufferPool_t* pool )
+{
+    assert( pool != 0 && "Pool must not be null!" );
+
+    BufferSlab_t* slab = pool->free_slabs;
+
+    if( slab != 0 )
+    {
+        pool->free_slabs = slab->next;
+    }
+    else
+    {
+        slab = malloc( BUFFER_POOL_SLAB_SIZE );
+        if( slab == 0 ) { return 0; }
+
+        ++pool->allocated;
+    }
+
+    if( ++pool->in_use > pool->peak_in_use ) { pool->peak_in_use = pool->in_use; }
+
+    return ( char* ) slab;
+}
+
+inline static void buffer_pool_return( BufferPool_t* pool, char* buffer )
+{
+    assert( pool != 0 && "Pool must not be null!" );
+
+    if( buffer == 0 ) { return; }
+
+    BufferSlab_t* slab  = ( BufferSlab_t* ) buffer;
+    slab->next          = pool->free_slabs;
+    pool->free_slabs    = slab;
+
+    --pool->in_use;
+}
+
+inline static void buffer_pool_free( BufferPool_t* pool )
+{
+    assert( pool != 0 && "Pool must not be null!" );
+    assert( pool->in_use == 0 && "Every slab must be returned before the pool is freed!" );
+
+    while( pool->free_slabs != 0 )
+    {
+        BufferSlab_t* next = pool->free_slabs->next;
+        free( pool->free_slabs );
+        pool->free_slabs = next;
+    }
+
+    memset( pool, 0, sizeof( BufferPool_t ) );
+}
+
+#endif // __BUFFER_POOL_H__
@@ -0,0 +1,74 @@
+#ifndef __CLIENT_CONTEXT_H__
+#define __CLIENT_CONTEXT_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <cyassl/ssl.h>
+
+#include "debug.h"
+#include "tls_io.h"
+#include "trust_store.h"
+
+/**
+ * \brief   Creates the CyaSSL context the client connections share, with the
+ *          staging receive and send callbacks, the suites of cipher_list
+ *          (0 keeps the ones of CyaSSL) and peer verification against verify,
+ *          a PEM file or "embedded", 0 does not verify, trust_load_us gets
+ *          the time the anchors took to load unless it is 0
+ * \return  context if successfull 0 other way
+ */
+inline static CYASSL_CTX* client_context_new( const char* cipher_list, const char* verify, uint64_t* trust_load_us )
+{
+    CYASSL_CTX* cya_ctx = CyaSSL_CTX_new( CyaSSLv23_client_method() );
+    if( cya_ctx == 0 ) { return 0; }
+
+    CyaSSL_SetIORecv( cya_ctx, myPrivateRecv );
+    CyaSSL_SetIOSend( cya_ctx, myPrivateSend );
+
+    if( cipher_list != 0 && CyaSSL_CTX_set_cipher_list( cya_ctx, cipher_list ) != SSL_SUCCESS )
+    {
+        error_fmt( "none of the cipher suites is supported: %s", cipher_list );
+        CyaSSL_CTX_free( cya_ctx );
+        return 0;
+    }
+
+    if( verify == 0 )
+    {
+        // disable verify cause no proper certificate
+        CyaSSL_CTX_set_verify( cya_ctx, SSL_VERIFY_NONE, 0 );
+        return cya_ctx;
+    }
+
+    struct timespec load_start;
+    clock_gettime( CLOCK_MONOTONIC, &load_start );
+
+    // the embedded anchors are already DER, nothing is read or decoded
+    int loaded = 0;
+
+    if( strcmp( verify, "embedded" ) == 0 )
+    {
+        loaded = load_trust_store( cya_ctx );
+    }
+    else
+    {
+        SSLCertConfig_t cert_config = { verify, 0 };
+        loaded = load_certificate( cya_ctx, &cert_config );
+    }
+
+    if( loaded < 0 )
+    {
+        error_fmt( "could not load the trust anchors of %s", verify );
+        CyaSSL_CTX_free( cya_ctx );
+        return 0;
+    }
+
+    if( trust_load_us != 0 ) { *trust_load_us = elapsed_us( &load_start ); }
+
+    CyaSSL_CTX_set_verify( cya_ctx, SSL_VERIFY_PEER, 0 );
+
+    return cya_ctx;
+}
+
+#endif // __CLIENT_CONTEXT_H__
@@ -0,0 +1,264 @@
+#ifndef __CRYPTO_POOL_H__
+#define __CRYPTO_POOL_H__
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+
+#include <cyassl/ssl.h>
+
+#include "tls_alloc.h"
+#include "tls_io.h"
+
+/**
+ * \struct CryptoJob_t
+ * \brief  One CyaSSL_connect step of a parked connection, it is embedded in
+ *          the connection and nothing but the crypto thread touches the
+ *          connection until the job is handed back
+ */
+typedef struct crypto_job
+{
+    struct crypto_job*      next;
+    CYASSL*                 ssl;
+    TlsArena_t*             arena;
+    struct crypto_done*     done;
+    int                     state;
+} CryptoJob_t;
+
+/**
+ * \struct CryptoDone_t
+ * \brief  Finished jobs of one event loop, the eventfd is watched by the loop
+ *          and wakes it up when the list stops being empty
+ */
+typedef struct crypto_done
+{
+    int                 event_fd;
+    pthread_mutex_t     lock;
+    CryptoJob_t*        head;
+    CryptoJob_t*        tail;
+} CryptoDone_t;
+
+/**
+ * \struct CryptoPool_t
+ * \brief  Threads that run the expensive handshake steps off the event
+ *          loops, the counters of the threads are merged when they exit
+ */
+typedef struct
+{
+    pthread_t*          threads;
+    int                 count;
+    pthread_mutex_t     lock;
+    pthread_cond_t      ready;
+    CryptoJob_t*        head;
+    CryptoJob_t*        tail;
+    int                 stop;
+    unsigned long long  jobs;
+    AllocStats_t        allocator;
+    SendStats_t         sends;
+} CryptoPool_t;
+
+inline static void crypto_job_list_push( CryptoJob_t** head, CryptoJob_t** tail, CryptoJob_t* job )
+{
+    job->next = 0;
+
+    if( *tail != 0 )    { ( *tail )->next = job; }
+    else                { *head = job; }
+
+    *tail = job;
+}
+
+/**
+ * \return  1 if successfull <0 other way
+ */
+inline static int crypto_done_init( CryptoDone_t* done )
+{
+    assert( done != 0 && "Done list must not be null!" );
+
+    memset( done, 0, sizeof( CryptoDone_t ) );
+
+    done->event_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if( done->event_fd < 0 ) { return -1; }
+
+    if( pthread_mutex_init( &done->lock, 0 ) != 0 )
+    {
+        close( done->event_fd );
+        done->event_fd = -1;
+        return -1;
+    }
+
+    return 1;
+}
+
+inline static void crypto_done_free( CryptoDone_t* done )
+{
+    assert( done != 0 && "Done list must not be null!" );
+    assert( done->head == 0 && "Every finished job must be taken before the list is freed!" );
+
+    if( done->event_fd < 0 ) { return; }
+
+    close( done->event_fd );
+    pthread_mutex_destroy( &done->lock );
+    done->event_fd = -1;
+}
+
+/**
+ * \brief   Hands a finished job back, the eventfd is written only when the
+ *          list was empty, the loop takes the whole list at once anyway
+ */
+inline static void crypto_done_push( CryptoDone_t* done, CryptoJob_t* job )
+{
+    pthread_mutex_lock( &done->lock );
+
+    int was_empty = done->head == 0;
+    crypto_job_list_push( &done->head, &done->tail, job );
+
+    pthread_mutex_unlock( &done->lock );
+
+    if( was_empty )
+    {
+        uint64_t one = 1;
+        while( write( done->event_fd, &one, sizeof( one ) ) < 0 && errno == EINTR ) { }
+    }
+}
+
+/**
+ * \brief   Takes every finished job, called by the loop once the eventfd
+ *          is readable, jobs finished meanwhile wake it up again
+ * \return  list of jobs chained through next, 0 if there is none
+ */
+inline static CryptoJob_t* crypto_done_take( CryptoDone_t* done )
+{
+    assert( done != 0 && "Done list must not be null!" );
+
+    uint64_t count = 0;
+    while( read( done->event_fd, &count, sizeof( count ) ) < 0 && errno == EINTR ) { }
+
+    pthread_mutex_lock( &done->lock );
+
+    CryptoJob_t* jobs   = done->head;
+    done->head          = 0;
+    done->tail          = 0;
+
+    pthread_mutex_unlock( &done->lock );
+
+    return jobs;
+}
+
+static void* crypto_pool_thread( void* arg )
+{
+    CryptoPool_t* pool = ( CryptoPool_t* ) arg;
+
+    pthread_mutex_lock( &pool->lock );
+
+    for( ; ; )
+    {
+        while( pool->head == 0 && !pool->stop ) { pthread_cond_wait( &pool->ready, &pool->lock ); }
+
+        // stopping drains the queue first
+        if( pool->head == 0 ) { break; }
+
+        CryptoJob_t* job = pool->head;
+        pool->head = job->next;
+        if( pool->head == 0 ) { pool->tail = 0; }
+
+        ++pool->jobs;
+
+        pthread_mutex_unlock( &pool->lock );
+
+        // the connection keeps its memory in its own arena wherever it runs
+        job->state = tls_connect_step( job->ssl, job->arena );
+
+        crypto_done_push( job->done, job );
+
+        pthread_mutex_lock( &pool->lock );
+    }
+
+    const AllocStats_t allocator = tls_alloc_thread_stats();
+    tls_alloc_stats_merge( &pool->allocator, &allocator );
+
+    pool->sends.calls       += tls_io_send_stats.calls;
+    pool->sends.syscalls    += tls_io_send_stats.syscalls;
+
+    pthread_mutex_unlock( &pool->lock );
+
+    tls_alloc_thread_release();
+
+    return 0;
+}
+
+/**
+ * \brief   Starts count crypto threads
+ * \return  1 if successfull <0 other way
+ */
+inline static int crypto_pool_init( CryptoPool_t* pool, int count )
+{
+    assert( pool != 0 && count > 0 && "Pool must not be null and needs a thread!" );
+
+    memset( pool, 0, sizeof( CryptoPool_t ) );
+
+    pool->threads = calloc( count, sizeof( pthread_t ) );
+    if( pool->threads == 0 ) { return -1; }
+
+    if( pthread_mutex_init( &pool->lock, 0 ) != 0 || pthread_cond_init( &pool->ready, 0 ) != 0 )
+    {
+        free( pool->threads );
+        return -1;
+    }
+
+    for( ; pool->count < count; ++pool->count )
+    {
+        if( pthread_create( &pool->threads[ pool->count ], 0, crypto_pool_thread, pool ) != 0 ) { return -1; }
+    }
+
+    return 1;
+}
+
+/**
+ * \brief   Queues the next CyaSSL_connect step of ssl, the state it left the
+ *          handshake in ends up in job->state once the job shows up in job->done
+ */
+inline static void crypto_pool_submit( CryptoPool_t* pool, CryptoJob_t* job, CYASSL* ssl, TlsArena_t* arena )
+{
+    assert( pool != 0 && job != 0 && ssl != 0 && "Pool, job and ssl must not be null!" );
+    assert( job->done != 0 && "Job must know where to go when it is done!" );
+
+    job->ssl    = ssl;
+    job->arena  = arena;
+    job->state  = 0;
+
+    pthread_mutex_lock( &pool->lock );
+    crypto_job_list_push( &pool->head, &pool->tail, job );
+    pthread_cond_signal( &pool->ready );
+    pthread_mutex_unlock( &pool->lock );
+}
+
+/**
+ * \brief   Runs the queued jobs to the end and joins the threads, the
+ *          counters stay readable
+ */
+inline static void crypto_pool_free( CryptoPool_t* pool )
+{
+    assert( pool != 0 && "Pool must not be null!" );
+
+    pthread_mutex_lock( &pool->lock );
+    pool->stop = 1;
+    pthread_cond_broadcast( &pool->ready );
+    pthread_mutex_unlock( &pool->lock );
+
+    for( int i = 0; i < pool->count; ++i ) { pthread_join( pool->threads[ i ], 0 ); }
+
+    pthread_cond_destroy( &pool->ready );
+    pthread_mutex_destroy( &pool->lock );
+    free( pool->threads );
+
+    pool->threads   = 0;
+    pool->count     = 0;
+}
+
+#endif // __CRYPTO_POOL_H__
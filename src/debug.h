@@ -1,16 +1,53 @@
+
 #ifndef __DEBUG_H__
 #define __DEBUG_H__
 
 #include <stdio.h>
 
+#define DEBUG_LEVEL_NONE        0
+#define DEBUG_LEVEL_ERROR       1
+#define DEBUG_LEVEL_INFO        2
+#define DEBUG_LEVEL_DEBUG       3
+
+// everything is on unless the build says otherwise, release builds keep the errors only
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL DEBUG_LEVEL_DEBUG
+#endif
+
+#ifdef DEBUG_ASYNC
+// formatted on the calling thread, written out by a background thread
+#include "debug_ring.h"
+#define debug_printf( ... ) debug_ring_printf( __VA_ARGS__ )
+#define debug_flush()
+#define debug_init()        debug_ring_start()
+#else
 #define debug_printf( ... ) printf( __VA_ARGS__ )
+#define debug_flush()       fflush( stdout )
+#define debug_init()
+#endif
+
+// disabled levels stay type checked but generate no code
+#define debug_level_enabled( level ) ( ( level ) <= DEBUG_LEVEL )
+
+#define debug_level_log( level, msg ) \
+    do { if( debug_level_enabled( level ) ) { \
+        debug_printf( "[%s@%d] - %s\r\n", __FILE__, __LINE__, msg ); \
+        debug_flush(); \
+    } } while( 0 )
+
+#define debug_level_fmt( level, fmt, ... ) \
+    do { if( debug_level_enabled( level ) ) { \
+        debug_printf( "[%s@%d] - " fmt "\r\n", __FILE__, __LINE__, __VA_ARGS__ ); \
+        debug_flush(); \
+    } } while( 0 )
+
+#define debug_log( msg )            debug_level_log( DEBUG_LEVEL_DEBUG, msg )
+#define debug_fmt( fmt, ... )       debug_level_fmt( DEBUG_LEVEL_DEBUG, fmt, __VA_ARGS__ )
 
-#define debug_log( msg ) \
-    debug_printf( "[%s@%d] - %s\r\n", __FILE__, __LINE__, msg ); \
-    fflush( stdout )
+#define info_log( msg )             debug_level_log( DEBUG_LEVEL_INFO, msg )
+#define info_fmt( fmt, ... )        debug_level_fmt( DEBUG_LEVEL_INFO, fmt, __VA_ARGS__ )
 
-#define debug_fmt( fmt, ... ) \
-    debug_printf( "[%s@%d] - " fmt "\r\n", __FILE__, __LINE__, __VA_ARGS__ ); \
-    fflush( stdout )
+#define error_log( msg )            debug_level_log( DEBUG_LEVEL_ERROR, msg )
+#define error_fmt( fmt, ... )       debug_level_fmt( DEBUG_LEVEL_ERROR, fmt, __VA_ARGS__ )
 
 #endif // __DEBUG_H__
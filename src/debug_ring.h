@@ -0,0 +1,176 @@
+#ifndef __DEBUG_RING_H__
+#define __DEBUG_RING_H__
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// must be a power of two
+#define DEBUG_RING_SLOTS        4096
+#define DEBUG_RING_MSG_SIZE     256
+#define DEBUG_RING_IDLE_NS      ( 1000 * 1000 )
+
+/**
+ * \struct DebugRingSlot_t
+ * \brief  One message, the sequence tells producers and the consumer
+ *          whose turn it is to touch the slot
+ */
+typedef struct
+{
+    atomic_size_t   sequence;
+    char            msg[ DEBUG_RING_MSG_SIZE ];
+} DebugRingSlot_t;
+
+/**
+ * \struct DebugRing_t
+ * \brief  Bounded lock-free multi producer single consumer queue of log
+ *          lines, producers never block, when the ring is full the line is
+ *          dropped and counted
+ */
+typedef struct
+{
+    DebugRingSlot_t slots[ DEBUG_RING_SLOTS ];
+    atomic_size_t   head;
+    size_t          tail;
+    atomic_ulong    dropped;
+    atomic_int      running;
+    int             started;
+    pthread_t       thread;
+} DebugRing_t;
+
+static DebugRing_t debug_ring;
+
+inline static void debug_ring_printf( const char* fmt, ... ) __attribute__( ( format( printf, 1, 2 ) ) );
+
+inline static void debug_ring_printf( const char* fmt, ... )
+{
+    size_t pos = atomic_load_explicit( &debug_ring.head, memory_order_relaxed );
+    DebugRingSlot_t* slot = 0;
+
+    for( ; ; )
+    {
+        slot = &debug_ring.slots[ pos & ( DEBUG_RING_SLOTS - 1 ) ];
+
+        size_t seq  = atomic_load_explicit( &slot->sequence, memory_order_acquire );
+        long dif    = ( long ) seq - ( long ) pos;
+
+        if( dif == 0 )
+        {
+            if( atomic_compare_exchange_weak_explicit(
+                      &debug_ring.head, &pos, pos + 1
+                    , memory_order_relaxed, memory_order_relaxed ) )
+            {
+                break;
+            }
+        }
+        else if( dif < 0 )
+        {
+            // full, the hot path must not wait for the writer thread
+            atomic_fetch_add_explicit( &debug_ring.dropped, 1, memory_order_relaxed );
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit( &debug_ring.head, memory_order_relaxed );
+        }
+    }
+
+    va_list args;
+    va_start( args, fmt );
+    vsnprintf( slot->msg, sizeof( slot->msg ), fmt, args );
+    va_end( args );
+
+    atomic_store_explicit( &slot->sequence, pos + 1, memory_order_release );
+}
+
+/**
+ * \brief   Writes out every published line
+ * \return  number of lines written
+ */
+inline static int debug_ring_drain( void )
+{
+    int written = 0;
+
+    for( ; ; )
+    {
+        DebugRingSlot_t* slot = &debug_ring.slots[ debug_ring.tail & ( DEBUG_RING_SLOTS - 1 ) ];
+
+        if( atomic_load_explicit( &slot->sequence, memory_order_acquire ) != debug_ring.tail + 1 )
+        {
+            break;
+        }
+
+        fputs( slot->msg, stdout );
+
+        atomic_store_explicit( &slot->sequence, debug_ring.tail + DEBUG_RING_SLOTS, memory_order_release );
+        ++debug_ring.tail;
+        ++written;
+    }
+
+    unsigned long dropped = atomic_exchange_explicit( &debug_ring.dropped, 0, memory_order_relaxed );
+
+    if( dropped )
+    {
+        fprintf( stdout, "[debug_ring] - %lu messages dropped\r\n", dropped );
+    }
+
+    if( written ) { fflush( stdout ); }
+
+    return written;
+}
+
+static void* debug_ring_run( void* arg )
+{
+    ( void ) arg;
+
+    const struct timespec idle = { 0, DEBUG_RING_IDLE_NS };
+
+    while( atomic_load_explicit( &debug_ring.running, memory_order_relaxed ) )
+    {
+        if( debug_ring_drain() == 0 ) { nanosleep( &idle, 0 ); }
+    }
+
+    debug_ring_drain();
+
+    return 0;
+}
+
+inline static void debug_ring_stop( void )
+{
+    if( !debug_ring.started ) { return; }
+
+    atomic_store( &debug_ring.running, 0 );
+    pthread_join( debug_ring.thread, 0 );
+    debug_ring.started = 0;
+}
+
+/**
+ * \brief   Starts the writer thread, has to be called before the first line
+ *          is logged, the remaining lines are flushed at exit
+ */
+inline static void debug_ring_start( void )
+{
+    if( debug_ring.started ) { return; }
+
+    for( size_t i = 0; i < DEBUG_RING_SLOTS; ++i )
+    {
+        atomic_init( &debug_ring.slots[ i ].sequence, i );
+    }
+
+    atomic_init( &debug_ring.head, 0 );
+    debug_ring.tail = 0;
+    atomic_init( &debug_ring.running, 1 );
+
+    if( pthread_create( &debug_ring.thread, 0, debug_ring_run, 0 ) != 0 )
+    {
+        return;
+    }
+
+    debug_ring.started = 1;
+    atexit( debug_ring_stop );
+}
+
+#endif // __DEBUG_RING_H__
@@ -0,0 +1,164 @@
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+
+typedef enum event_type
+{
+    FD_CAN_READ    = 0,
+    FD_CAN_WRITE
+} event_type_t;
+
+typedef enum wanted_event
+{
+    WANT_READ = 2,
+    WANT_WRITE,
+    // not an fd event, the connection is parked until a crypto thread is done
+    WANT_CRYPTO
+} wanted_event_t;
+
+/**
+ * \struct EventLoop_t
+ * \brief  epoll based reactor, every registered fd carries a user pointer
+ *          that is handed back when the fd becomes ready
+ */
+typedef struct
+{
+    int                 epoll_fd;
+    int                 max_events;
+    struct epoll_event* events;
+} EventLoop_t;
+
+/**
+ * \struct EventHandle_t
+ * \brief  Registration of a single fd, the interest is cached so that
+ *          re-arming with the same event does not cost a syscall
+ */
+typedef struct
+{
+    int             fd;
+    wanted_event_t  interest;
+    int             registered;
+} EventHandle_t;
+
+inline static uint32_t event_loop_epoll_events( wanted_event_t wanted_event )
+{
+    return wanted_event == WANT_READ ? EPOLLIN : EPOLLOUT;
+}
+
+/**
+ * \brief   Creates the epoll instance and the buffer for ready events
+ * \return  1 if successfull <0 other way
+ */
+inline static int event_loop_init( EventLoop_t* loop, int max_events )
+{
+    assert( loop != 0 && "Event loop must not be null!" );
+    assert( max_events > 0 && "Event loop needs room for at least one event!" );
+
+    memset( loop, 0, sizeof( EventLoop_t ) );
+
+    loop->epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    if( loop->epoll_fd < 0 ) { return -1; }
+
+    loop->events = calloc( max_events, sizeof( struct epoll_event ) );
+    if( loop->events == 0 )
+    {
+        close( loop->epoll_fd );
+        loop->epoll_fd = -1;
+        return -1;
+    }
+
+    loop->max_events = max_events;
+
+    return 1;
+}
+
+inline static void event_loop_free( EventLoop_t* loop )
+{
+    assert( loop != 0 && "Event loop must not be null!" );
+
+    if( loop->epoll_fd >= 0 ) { close( loop->epoll_fd ); }
+    free( loop->events );
+
+    loop->epoll_fd      = -1;
+    loop->events        = 0;
+    loop->max_events    = 0;
+}
+
+/**
+ * \brief   Registers or re-arms the handle with the wanted event, data is
+ *          returned by event_loop_data once the fd is ready
+ * \return  1 if successfull <0 other way
+ */
+inline static int event_loop_watch(
+                          EventLoop_t*      loop
+                        , EventHandle_t*    handle
+                        , wanted_event_t    wanted_event
+                        , void*             data )
+{
+    assert( loop != 0 && handle != 0 && "Event loop and handle must not be null!" );
+    assert( wanted_event != WANT_CRYPTO && "Crypto jobs are not fd events!" );
+
+    if( handle->registered && handle->interest == wanted_event )
+    {
+        return 1;
+    }
+
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+
+    ev.events   = event_loop_epoll_events( wanted_event );
+    ev.data.ptr = data;
+
+    int op = handle->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+    if( epoll_ctl( loop->epoll_fd, op, handle->fd, &ev ) < 0 )
+    {
+        return -1;
+    }
+
+    handle->interest    = wanted_event;
+    handle->registered  = 1;
+
+    return 1;
+}
+
+/**
+ * \brief   Removes the handle from the loop, must be called before the fd
+ *          gets closed
+ */
+inline static void event_loop_unwatch( EventLoop_t* loop, EventHandle_t* handle )
+{
+    assert( loop != 0 && handle != 0 && "Event loop and handle must not be null!" );
+
+    if( !handle->registered ) { return; }
+
+    epoll_ctl( loop->epoll_fd, EPOLL_CTL_DEL, handle->fd, 0 );
+    handle->registered = 0;
+}
+
+/**
+ * \brief   Waits for the registered fds
+ * \return  number of ready fds, 0 on timeout, <0 on error
+ */
+inline static int event_loop_wait( EventLoop_t* loop, int timeout_ms )
+{
+    assert( loop != 0 && "Event loop must not be null!" );
+
+    return epoll_wait( loop->epoll_fd, loop->events, loop->max_events, timeout_ms );
+}
+
+inline static void* event_loop_data( const EventLoop_t* loop, int i )
+{
+    assert( loop != 0 && i < loop->max_events && "Index out of range!" );
+
+    return loop->events[ i ].data.ptr;
+}
+
+#endif // __EVENT_LOOP_H__
@@ -12,101 +12,51 @@
 #include <arpa/inet.h>
 
 #include "debug.h"
-
-/**
- * \struct SSLCertConfig_t
- * \brief  This structure shall hold data related via the loading function
- *          should contain the information
- */
-typedef struct
-{
-    const char* file;
-    const char* path;
-} SSLCertConfig_t;
-
-/**
- * \brief To be able to pass data between functions
- */
-typedef struct
-{
-  int                   sock_fd;
-  struct sockaddr_in    endpoint_addr;
-} Conn_t;
+#include "client_context.h"
+#include "tls_io.h"
 
 //function prototypes
 CYASSL_CTX* init_cyaSSL( void );
-int load_certificate( CYASSL_CTX* cya_ctx, const SSLCertConfig_t* cert_config );
-CYASSL* connectSSL( CYASSL_CTX* cya_ctx, const Conn_t* conn );
+CYASSL* connectSSL( CYASSL_CTX* cya_ctx, Conn_t* conn );
 void print_usage( void );
-CYASSL* closeSSL( CYASSL* cyaSSLObject, Conn_t* conn );
 char* load_file_into_memory( const char* filename, size_t* size );
 
 /**
- * \brief   Initializes the cyassl library and creates the context
- * \return  1 if successfull <0 other way
+ * \brief   Initializes the cyassl library and creates the context, set up
+ *          like the one of the other clients
+ * \return  context if successfull 0 other way
  */
 CYASSL_CTX* init_cyaSSL( void )
 {
     CyaSSL_Init();
 
-    return CyaSSL_CTX_new( CyaSSLv23_client_method() );
-}
-
-/**
- * \brief   Loads the certificate defined through the SSLCertConfig_t
- * \return  1 if successfull <0 other way
- */
-int load_certificate( CYASSL_CTX* cya_ctx, const SSLCertConfig_t* cert_config )
-{
-    assert( cya_ctx != 0 && "CyaSSL context must not be null!" );
-    assert( cert_config != 0 && "CyaSSL certificate configuration must not be null!" );
-    assert( cert_config->file != 0 && "CyaSSL certificate filename must not be null!" );
-
-    printf( "Trying to load certificate: file %s at %s dir\n", cert_config->file, cert_config->path );
-    int ret = CyaSSL_CTX_load_verify_locations( cya_ctx, cert_config->file, 0 );
-
-    printf( "Ret: %d\n", ret );
-
-    if( ret < 0 )
-    {
-        return -1; //@TODO add proper cya err detection
-    }
-
-    return 1;
+    // disable verify cause no proper certificate
+    return client_context_new( 0, 0, 0 );
 }
 
 /**
- * \brief   connects
+ * \brief   connects, the socket blocks so every handshake step completes
  * \return  CYASSL object if ok 0 otherway
  */
-CYASSL* connectSSL( CYASSL_CTX* cya_ctx, const Conn_t* conn )
+CYASSL* connectSSL( CYASSL_CTX* cya_ctx, Conn_t* conn )
 {
     assert( cya_ctx != 0 && "CyaSSL context must not be null!" );
     assert( conn != 0 && "Conn ptr must not be null!" );
 
-    CYASSL* xCyaSSL_Object = 0;
-
     /* Standard Berkeley sockets connect function. */
-    if( connect( conn->sock_fd, ( struct sockaddr* ) &conn->endpoint_addr, sizeof( conn->endpoint_addr ) ) == 0 )
-    {
-        xCyaSSL_Object = CyaSSL_new( cya_ctx );
+    if( conn_connect_start( conn, 0 ) <= 0 ) { return 0; }
 
-        if( xCyaSSL_Object != NULL )
-        {
-            /* Associate the created CyaSSL object with the connected socket. */
-            CyaSSL_set_fd( xCyaSSL_Object, conn->sock_fd );
+    CYASSL* xCyaSSL_Object = create_cyassl_object( cya_ctx, conn );
 
-            if( CyaSSL_connect( xCyaSSL_Object ) != SSL_SUCCESS )
-            {
-                return 0;
-            }
-
-            return xCyaSSL_Object;
-        }
+    if( xCyaSSL_Object == 0 ) { return 0; }
 
+    if( tls_connect_step( xCyaSSL_Object, &conn->arena ) != SSL_SUCCESS )
+    {
+        closeSSL( xCyaSSL_Object, conn );
+        return 0;
     }
 
-    return 0;
+    return xCyaSSL_Object;
 }
 
 void print_usage( void )
@@ -114,41 +64,6 @@ void print_usage( void )
     printf( "Usage: example_01 <server_ip> <port> <filename>\n" );
 }
 
-inline static void DIE( const char msg[], CYASSL* cyaSSLObject )
-{
-    char* err_buffer        = 0;
-    char buffer[ 256 ]      = { '\0' };
-
-    int err = errno;
-
-    debug_fmt( "exiting: %s", msg );
-    err_buffer = strerror( err );
-    debug_fmt( "errno: %s", err_buffer );
-
-    if( cyaSSLObject != 0 )
-    {
-        int cyaErr = CyaSSL_get_error( cyaSSLObject, 0 );
-        CyaSSL_ERR_error_string( cyaErr, buffer );
-        debug_fmt( "CyaSSLErr: %d -> %s", cyaErr, buffer );
-    }
-
-    exit( -1 );
-}
-
-CYASSL* closeSSL( CYASSL* cyaSSLObject, Conn_t* conn )
-{
-    if( shutdown( conn->sock_fd, SHUT_RDWR ) < 0 )
-    {
-        printf( "Shutdown failed...\n" );
-    }
-
-    close( conn->sock_fd );
-
-    CyaSSL_free( cyaSSLObject );
-
-    return 0;
-}
-
 char* load_file_into_memory( const char* filename, size_t* size )
 {
     assert( filename != 0 && "Filename must not be null!" );
@@ -226,9 +141,6 @@ int main( const int argc, const char** argv )
         DIE( "CyaSSL initialization fault...", 0 );
     }
 
-    // disable verify cause no proper certificate
-    CyaSSL_CTX_set_verify( cyaSSLContext, SSL_VERIFY_NONE, 0 );
-
     /*if( load_certificate( cyaSSLContext, &cert_config ) < 0 )
     {
         DIE( "CyaSSL load/verification certificate problem", 0 );
@@ -0,0 +1,231 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+
+#include "lib/nbtls.h"
+#include "http_parser.h"
+
+#define EXAMPLE03_MAX_EVENTS    64
+
+/**
+ * \brief What the application keeps next to each library connection
+ */
+typedef struct
+{
+    NbTlsConn_t*    tls;
+    uint32_t        events;
+    int             queued;
+    HttpParser_t    response;
+} AppConn_t;
+
+/**
+ * \brief   Reads the whole request file
+ * \return  1 if successfull <0 other way
+ */
+inline static int read_request( const char* filename, char** data, size_t* size )
+{
+    int fd = open( filename, O_RDONLY );
+    if( fd < 0 ) { return -1; }
+
+    struct stat st;
+    if( fstat( fd, &st ) < 0 || ( *data = malloc( st.st_size ) ) == 0 )
+    {
+        close( fd );
+        return -1;
+    }
+
+    *size = 0;
+
+    while( *size < ( size_t ) st.st_size )
+    {
+        ssize_t got = read( fd, *data + *size, st.st_size - *size );
+        if( got <= 0 )
+        {
+            close( fd );
+            return -1;
+        }
+
+        *size += got;
+    }
+
+    close( fd );
+
+    return 1;
+}
+
+/**
+ * \brief   Registers the connection for whatever it waits for, level
+ *          triggered so nothing is lost between two steps
+ * \return  1 if successfull <0 other way
+ */
+inline static int app_conn_watch( int epoll_fd, AppConn_t* app )
+{
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+
+    ev.events   = nbtls_conn_interest( app->tls ) == NBTLS_WANT_WRITE ? EPOLLOUT : EPOLLIN;
+    ev.data.ptr = app;
+
+    if( ev.events == app->events ) { return 1; }
+
+    int op          = app->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    app->events     = ev.events;
+
+    return epoll_ctl( epoll_fd, op, nbtls_conn_fd( app->tls ), &ev ) < 0 ? -1 : 1;
+}
+
+/**
+ * \brief   Moves the connection as far as its socket allows, handshake,
+ *          request and response
+ * \return  1 once the response is complete, 0 if it waits, <0 on error
+ */
+inline static int app_conn_drive( int epoll_fd, AppConn_t* app, const char* request, size_t request_size )
+{
+    char buffer[ 16384 ];
+
+    for( ; ; )
+    {
+        nbtls_state_t state = nbtls_conn_step( app->tls );
+
+        if( state == NBTLS_FAILED ) { return -1; }
+
+        // still handshaking or staged records wait for the socket
+        if( state != NBTLS_ESTABLISHED || nbtls_conn_interest( app->tls ) != NBTLS_WANT_NONE ) { break; }
+
+        // the next step writes the request out, however many tries it takes
+        if( !app->queued )
+        {
+            if( nbtls_conn_queue( app->tls, request, request_size ) != 1 ) { return -1; }
+
+            app->queued = 1;
+            continue;
+        }
+
+        long received = nbtls_conn_receive( app->tls, buffer, sizeof( buffer ) );
+
+        if( received == NBTLS_AGAIN )   { break; }
+        if( received < 0 )              { return -1; }
+        if( received == 0 )            { return http_parser_finish( &app->response ); }
+
+        if( http_parser_feed( &app->response, buffer, ( size_t ) received ) < 0 ) { return -1; }
+        if( http_parser_done( &app->response ) ) { return 1; }
+    }
+
+    return app_conn_watch( epoll_fd, app ) < 0 ? -1 : 0;
+}
+
+/**
+ * \main
+ */
+int main( const int argc, char* const* argv )
+{
+    int connections = 1;
+    int opt         = 0;
+
+    while( ( opt = getopt( argc, argv, "c:" ) ) != -1 )
+    {
+        if( opt == 'c' && ( connections = atoi( optarg ) ) > 0 ) { continue; }
+
+        printf( "Usage: %s [-c connections] <server_ip> <port> <filename>\n", argv[ 0 ] );
+        exit( 1 );
+    }
+
+    if( argc - optind != 3 )
+    {
+        printf( "Usage: %s [-c connections] <server_ip> <port> <filename>\n", argv[ 0 ] );
+        exit( 1 );
+    }
+
+    char* request       = 0;
+    size_t request_size = 0;
+
+    if( read_request( argv[ optind + 2 ], &request, &request_size ) < 0 )
+    {
+        printf( "Could not read %s\n", argv[ optind + 2 ] );
+        exit( 1 );
+    }
+
+    struct sockaddr_in endpoint;
+    memset( &endpoint, 0, sizeof( endpoint ) );
+
+    endpoint.sin_family         = AF_INET;
+    endpoint.sin_addr.s_addr    = inet_addr( argv[ optind ] );
+    endpoint.sin_port           = htons( atoi( argv[ optind + 1 ] ) );
+
+    // the example owns the whole process, so it opts in to the pooled allocator
+    if( nbtls_init( 1 ) < 0 ) { printf( "nbtls_init failed\n" ); exit( 1 ); }
+
+    NbTlsContext_t* context = nbtls_context_new( 0 );
+    if( context == 0 ) { printf( "nbtls_context_new failed\n" ); exit( 1 ); }
+
+    // the event loop belongs to the application, the library only reports
+    // the fd and interest of each connection
+    int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    if( epoll_fd < 0 ) { printf( "epoll_create1 failed\n" ); exit( 1 ); }
+
+    AppConn_t* apps = calloc( connections, sizeof( AppConn_t ) );
+    int pending     = 0;
+    int completed   = 0;
+    int failed      = 0;
+
+    for( int i = 0; i < connections; ++i )
+    {
+        http_parser_init( &apps[ i ].response );
+        apps[ i ].tls = nbtls_conn_new( context, &endpoint );
+
+        int ret = apps[ i ].tls != 0 ? app_conn_drive( epoll_fd, &apps[ i ], request, request_size ) : -1;
+
+        if( ret == 0 ) { ++pending; } else if( ret > 0 ) { ++completed; } else { ++failed; }
+    }
+
+    struct epoll_event events[ EXAMPLE03_MAX_EVENTS ];
+
+    while( pending > 0 )
+    {
+        int count = epoll_wait( epoll_fd, events, EXAMPLE03_MAX_EVENTS, -1 );
+
+        if( count < 0 && errno == EINTR ) { continue; }
+        if( count < 0 ) { break; }
+
+        for( int i = 0; i < count; ++i )
+        {
+            AppConn_t* app  = ( AppConn_t* ) events[ i ].data.ptr;
+            int ret         = app_conn_drive( epoll_fd, app, request, request_size );
+
+            if( ret == 0 ) { continue; }
+
+            epoll_ctl( epoll_fd, EPOLL_CTL_DEL, nbtls_conn_fd( app->tls ), 0 );
+            app->events = 0;
+            --pending;
+
+            if( ret > 0 ) { ++completed; } else { ++failed; }
+        }
+    }
+
+    for( int i = 0; i < connections; ++i )
+    {
+        if( apps[ i ].tls != 0 && apps[ i ].response.status_code != 0 )
+        {
+            printf( "connection %d: HTTP %d, %llu body bytes\n", i, apps[ i ].response.status_code, apps[ i ].response.body_size );
+        }
+
+        nbtls_conn_free( apps[ i ].tls );
+    }
+
+    printf( "done: %d connections, %d responses, %d failed\n", connections, completed, failed );
+
+    free( apps );
+    close( epoll_fd );
+    nbtls_context_free( context );
+    nbtls_cleanup();
+    free( request );
+
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,139 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// 2^SUB_BITS linear buckets per power of two, that is ~1.6% relative precision
+#define HISTOGRAM_SUB_BITS      6
+#define HISTOGRAM_SUB_COUNT     ( 1 << HISTOGRAM_SUB_BITS )
+// values up to 2^MAX_BITS - 1, with microseconds that is roughly 12 days
+#define HISTOGRAM_MAX_BITS      40
+#define HISTOGRAM_BUCKETS       ( HISTOGRAM_SUB_COUNT + ( HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS ) * HISTOGRAM_SUB_COUNT )
+
+/**
+ * \struct Histogram_t
+ * \brief  HDR style log-linear histogram, recording is a couple of shifts
+ *          and an increment, so it can sit on the hot path
+ */
+typedef struct
+{
+    uint64_t    counts[ HISTOGRAM_BUCKETS ];
+    uint64_t    total;
+    uint64_t    min;
+    uint64_t    max;
+    double      sum;
+} Histogram_t;
+
+inline static void histogram_init( Histogram_t* h )
+{
+    assert( h != 0 && "Histogram must not be null!" );
+
+    memset( h, 0, sizeof( Histogram_t ) );
+    h->min = UINT64_MAX;
+}
+
+inline static int histogram_index( uint64_t value )
+{
+    if( value < HISTOGRAM_SUB_COUNT ) { return ( int ) value; }
+
+    int msb     = 63 - __builtin_clzll( value );
+    int shift   = msb - HISTOGRAM_SUB_BITS;
+
+    if( msb >= HISTOGRAM_MAX_BITS ) { return HISTOGRAM_BUCKETS - 1; }
+
+    return HISTOGRAM_SUB_COUNT + shift * HISTOGRAM_SUB_COUNT + ( int ) ( ( value >> shift ) - HISTOGRAM_SUB_COUNT );
+}
+
+/**
+ * \brief   Highest value that falls into the bucket
+ */
+inline static uint64_t histogram_bucket_value( int index )
+{
+    if( index < HISTOGRAM_SUB_COUNT ) { return ( uint64_t ) index; }
+
+    int shift       = ( index - HISTOGRAM_SUB_COUNT ) / HISTOGRAM_SUB_COUNT;
+    uint64_t sub    = ( uint64_t ) ( ( index - HISTOGRAM_SUB_COUNT ) % HISTOGRAM_SUB_COUNT );
+
+    return ( ( HISTOGRAM_SUB_COUNT + sub ) << shift ) + ( ( ( uint64_t ) 1 << shift ) - 1 );
+}
+
+inline static void histogram_record( Histogram_t* h, uint64_t value )
+{
+    ++h->counts[ histogram_index( value ) ];
+    ++h->total;
+    h->sum += ( double ) value;
+
+    if( value < h->min ) { h->min = value; }
+    if( value > h->max ) { h->max = value; }
+}
+
+inline static void histogram_merge( Histogram_t* dst, const Histogram_t* src )
+{
+    assert( dst != 0 && src != 0 && "Histograms must not be null!" );
+
+    for( int i = 0; i < HISTOGRAM_BUCKETS; ++i )
+    {
+        dst->counts[ i ] += src->counts[ i ];
+    }
+
+    dst->total  += src->total;
+    dst->sum    += src->sum;
+
+    if( src->min < dst->min ) { dst->min = src->min; }
+    if( src->max > dst->max ) { dst->max = src->max; }
+}
+
+/**
+ * \brief   Value below which the given percentage of the recorded values lie
+ */
+inline static uint64_t histogram_percentile( const Histogram_t* h, double percentile )
+{
+    assert( h != 0 && "Histogram must not be null!" );
+
+    if( h->total == 0 ) { return 0; }
+
+    uint64_t wanted = ( uint64_t ) ( ( percentile / 100.0 ) * ( double ) h->total + 0.5 );
+    uint64_t seen   = 0;
+
+    if( wanted == 0 ) { wanted = 1; }
+
+    for( int i = 0; i < HISTOGRAM_BUCKETS; ++i )
+    {
+        seen += h->counts[ i ];
+
+        if( seen >= wanted )
+        {
+            uint64_t value = histogram_bucket_value( i );
+            return value > h->max ? h->max : value;
+        }
+    }
+
+    return h->max;
+}
+
+inline static void histogram_print( const Histogram_t* h, const char* name, const char* unit )
+{
+    assert( h != 0 && name != 0 && unit != 0 && "Histogram, name and unit must not be null!" );
+
+    if( h->total == 0 )
+    {
+        printf( "%-12s no samples\n", name );
+        return;
+    }
+
+    printf( "%-12s n %llu min %llu p50 %llu p99 %llu p999 %llu max %llu mean %.1f [%s]\n"
+        , name
+        , ( unsigned long long ) h->total
+        , ( unsigned long long ) h->min
+        , ( unsigned long long ) histogram_percentile( h, 50.0 )
+        , ( unsigned long long ) histogram_percentile( h, 99.0 )
+        , ( unsigned long long ) histogram_percentile( h, 99.9 )
+        , ( unsigned long long ) h->max
+        , h->sum / ( double ) h->total
+        , unit );
+}
+
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,285 @@
+#ifndef __HTTP_PARSER_H__
+#define __HTTP_PARSER_H__
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// longest status, header or chunk size line that is accepted
+#define HTTP_PARSER_LINE_MAX    1024
+
+/**
+ * \brief States of the response parser, each one knows what the next byte
+ *          means so parsing can stop and resume at any byte
+ */
+typedef enum http_parse_state
+{
+    HTTP_PARSE_STATUS_LINE  = 0,
+    HTTP_PARSE_HEADERS,
+    HTTP_PARSE_BODY_LENGTH,
+    HTTP_PARSE_CHUNK_SIZE,
+    HTTP_PARSE_CHUNK_DATA,
+    HTTP_PARSE_CHUNK_DATA_END,
+    HTTP_PARSE_TRAILERS,
+    HTTP_PARSE_BODY_UNTIL_CLOSE,
+    HTTP_PARSE_DONE,
+    HTTP_PARSE_ERROR
+} http_parse_state_t;
+
+/**
+ * \struct HttpParser_t
+ * \brief  Incremental HTTP/1.1 response parser, it owns the partial line it
+ *          is in the middle of so it can be fed whatever each read returned
+ */
+typedef struct
+{
+    http_parse_state_t  state;
+    int                 status_code;
+    int                 chunked;
+    int                 has_content_length;
+    int                 connection_close;
+    unsigned long long  body_left;
+    unsigned long long  body_size;
+    size_t              line_size;
+    char                line[ HTTP_PARSER_LINE_MAX ];
+} HttpParser_t;
+
+inline static void http_parser_init( HttpParser_t* parser )
+{
+    assert( parser != 0 && "Parser must not be null!" );
+
+    parser->state               = HTTP_PARSE_STATUS_LINE;
+    parser->status_code         = 0;
+    parser->chunked             = 0;
+    parser->has_content_length  = 0;
+    parser->connection_close    = 0;
+    parser->body_left           = 0;
+    parser->body_size           = 0;
+    parser->line_size           = 0;
+}
+
+inline static int http_parser_done( const HttpParser_t* parser )
+{
+    return parser->state == HTTP_PARSE_DONE;
+}
+
+/**
+ * \brief   Case insensitive match of a header name, the value with its
+ *          leading blanks skipped is returned through value
+ * \return  1 if the line is that header 0 other way
+ */
+inline static int http_parser_header_is( const char* line, const char* name, const char** value )
+{
+    size_t name_size = strlen( name );
+
+    if( strncasecmp( line, name, name_size ) != 0 || line[ name_size ] != ':' ) { return 0; }
+
+    line += name_size + 1;
+    while( *line == ' ' || *line == '\t' ) { ++line; }
+
+    *value = line;
+
+    return 1;
+}
+
+/**
+ * \brief   Headers are done, picks how the end of the body is found
+ */
+inline static void http_parser_begin_body( HttpParser_t* parser )
+{
+    const int status = parser->status_code;
+
+    // interim responses are followed by the real one
+    if( status >= 100 && status < 200 )
+    {
+        http_parser_init( parser );
+        return;
+    }
+
+    if( status == 204 || status == 304 )
+    {
+        parser->state = HTTP_PARSE_DONE;
+    }
+    else if( parser->chunked )
+    {
+        parser->state = HTTP_PARSE_CHUNK_SIZE;
+    }
+    else if( parser->has_content_length )
+    {
+        parser->state = parser->body_left > 0 ? HTTP_PARSE_BODY_LENGTH : HTTP_PARSE_DONE;
+    }
+    else
+    {
+        parser->state               = HTTP_PARSE_BODY_UNTIL_CLOSE;
+        parser->connection_close    = 1;
+    }
+}
+
+/**
+ * \brief   Handles one complete line, the line ending is already stripped
+ */
+inline static void http_parser_line( HttpParser_t* parser )
+{
+    char* line          = parser->line;
+    const char* value   = 0;
+
+    switch( parser->state )
+    {
+        case HTTP_PARSE_STATUS_LINE:
+            if( strncmp( line, "HTTP/1.", 7 ) != 0 || line[ 8 ] != ' ' )
+            {
+                parser->state = HTTP_PARSE_ERROR;
+                return;
+            }
+
+            parser->status_code         = atoi( line + 9 );
+            parser->connection_close    = line[ 7 ] == '0';
+            parser->state               = parser->status_code >= 100 ? HTTP_PARSE_HEADERS : HTTP_PARSE_ERROR;
+            return;
+
+        case HTTP_PARSE_HEADERS:
+            if( parser->line_size == 0 )
+            {
+                http_parser_begin_body( parser );
+            }
+            else if( http_parser_header_is( line, "Content-Length", &value ) )
+            {
+                char* end                   = 0;
+                parser->body_left           = strtoull( value, &end, 10 );
+                parser->has_content_length  = end != value;
+            }
+            else if( http_parser_header_is( line, "Transfer-Encoding", &value ) )
+            {
+                parser->chunked = strcasestr( value, "chunked" ) != 0;
+            }
+            else if( http_parser_header_is( line, "Connection", &value ) )
+            {
+                if( strcasestr( value, "close" ) != 0 )        { parser->connection_close = 1; }
+                if( strcasestr( value, "keep-alive" ) != 0 )   { parser->connection_close = 0; }
+            }
+            return;
+
+        case HTTP_PARSE_CHUNK_SIZE:
+        {
+            char* end           = 0;
+            parser->body_left   = strtoull( line, &end, 16 );
+
+            // chunk extensions after ';' are ignored
+            if( end == line || ( *end != '\0' && *end != ';' && *end != ' ' ) )
+            {
+                parser->state = HTTP_PARSE_ERROR;
+                return;
+            }
+
+            parser->state = parser->body_left > 0 ? HTTP_PARSE_CHUNK_DATA : HTTP_PARSE_TRAILERS;
+            return;
+        }
+
+        case HTTP_PARSE_CHUNK_DATA_END:
+            parser->state = parser->line_size == 0 ? HTTP_PARSE_CHUNK_SIZE : HTTP_PARSE_ERROR;
+            return;
+
+        case HTTP_PARSE_TRAILERS:
+            if( parser->line_size == 0 ) { parser->state = HTTP_PARSE_DONE; }
+            return;
+
+        case HTTP_PARSE_BODY_LENGTH:
+        case HTTP_PARSE_CHUNK_DATA:
+        case HTTP_PARSE_BODY_UNTIL_CLOSE:
+        case HTTP_PARSE_DONE:
+        case HTTP_PARSE_ERROR:
+            parser->state = HTTP_PARSE_ERROR;
+            return;
+    }
+}
+
+/**
+ * \brief   Feeds the next bytes of the response, parsing stops right after
+ *          the end of the response so whatever follows belongs to the next one
+ * \return  number of bytes consumed if successfull <0 on a malformed response
+ */
+inline static long http_parser_feed( HttpParser_t* parser, const char* data, size_t size )
+{
+    assert( parser != 0 && ( data != 0 || size == 0 ) && "Parser and data must not be null!" );
+
+    size_t i = 0;
+
+    while( i < size && parser->state != HTTP_PARSE_DONE )
+    {
+        switch( parser->state )
+        {
+            case HTTP_PARSE_BODY_LENGTH:
+            case HTTP_PARSE_CHUNK_DATA:
+            {
+                // body bytes are counted and skipped in bulk
+                size_t take = size - i;
+                if( take > parser->body_left ) { take = ( size_t ) parser->body_left; }
+
+                i                   += take;
+                parser->body_left   -= take;
+                parser->body_size   += take;
+
+                if( parser->body_left == 0 )
+                {
+                    parser->state = parser->state == HTTP_PARSE_BODY_LENGTH ? HTTP_PARSE_DONE : HTTP_PARSE_CHUNK_DATA_END;
+                }
+                break;
+            }
+
+            case HTTP_PARSE_BODY_UNTIL_CLOSE:
+                parser->body_size   += size - i;
+                i                   = size;
+                break;
+
+            case HTTP_PARSE_DONE:
+            case HTTP_PARSE_ERROR:
+                return -1;
+
+            case HTTP_PARSE_STATUS_LINE:
+            case HTTP_PARSE_HEADERS:
+            case HTTP_PARSE_CHUNK_SIZE:
+            case HTTP_PARSE_CHUNK_DATA_END:
+            case HTTP_PARSE_TRAILERS:
+            {
+                // everything else is line based, lines may span several reads
+                char c = data[ i++ ];
+
+                if( c == '\n' )
+                {
+                    if( parser->line_size > 0 && parser->line[ parser->line_size - 1 ] == '\r' ) { --parser->line_size; }
+
+                    parser->line[ parser->line_size ] = '\0';
+                    http_parser_line( parser );
+                    parser->line_size = 0;
+                }
+                else if( parser->line_size + 1 < sizeof( parser->line ) )
+                {
+                    parser->line[ parser->line_size++ ] = c;
+                }
+                else
+                {
+                    parser->state = HTTP_PARSE_ERROR;
+                }
+                break;
+            }
+        }
+    }
+
+    return parser->state == HTTP_PARSE_ERROR ? -1 : ( long ) i;
+}
+
+/**
+ * \brief   The connection was closed, that ends a body delimited by the close
+ * \return  1 if the response is complete <0 if it was cut short
+ */
+inline static int http_parser_finish( HttpParser_t* parser )
+{
+    assert( parser != 0 && "Parser must not be null!" );
+
+    if( parser->state == HTTP_PARSE_BODY_UNTIL_CLOSE ) { parser->state = HTTP_PARSE_DONE; }
+
+    return parser->state == HTTP_PARSE_DONE ? 1 : -1;
+}
+
+#endif // __HTTP_PARSER_H__
@@ -0,0 +1,382 @@
+// the library logs into the stdout of the application, only errors unless
+// the build asks for more, and always from the calling thread
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL 1
+#endif
+
+#undef DEBUG_ASYNC
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cyassl/ssl.h>
+
+#include "nbtls.h"
+
+#include "../client_context.h"
+#include "../debug.h"
+#include "../send_queue.h"
+#include "../tls_alloc.h"
+#include "../tls_io.h"
+#include "../xi_coroutine.h"
+
+/**
+ * \brief CyaSSL context with the settings every connection of it shares
+ */
+struct nbtls_context
+{
+    CYASSL_CTX*         cya_ctx;
+    SocketProfile_t     socket_profile;
+    size_t              send_high_water;
+};
+
+/**
+ * \brief Single connection, the coroutine keeps its resume point in cs
+ */
+struct nbtls_conn
+{
+    short               cs;
+    int                 state;
+    nbtls_state_t       phase;
+    nbtls_interest_t    interest;
+    CYASSL*             cya_obj;
+    Conn_t              conn;
+    SendQueue_t         send_queue;
+    NbTlsContext_t*     context;
+};
+
+int nbtls_init( int pooled_allocator )
+{
+    // the hooks are process global and must see every allocation CyaSSL
+    // ever makes, so they are only installed when the application asks
+    if( pooled_allocator && tls_alloc_install( ALLOC_MODE_POOLED ) < 0 ) { return -1; }
+
+    CyaSSL_Init();
+
+    return 1;
+}
+
+void nbtls_cleanup( void )
+{
+    CyaSSL_Cleanup();
+
+    // only the pools of the calling thread, other threads release their own
+    tls_alloc_thread_release();
+}
+
+NbTlsContext_t* nbtls_context_new( const NbTlsConfig_t* config )
+{
+    NbTlsConfig_t defaults;
+    memset( &defaults, 0, sizeof( defaults ) );
+
+    if( config == 0 ) { config = &defaults; }
+
+    NbTlsContext_t* context = calloc( 1, sizeof( NbTlsContext_t ) );
+    if( context == 0 ) { return 0; }
+
+    if( config->socket_profile != 0 && socket_profile_parse( &context->socket_profile, config->socket_profile ) < 0 )
+    {
+        free( context );
+        return 0;
+    }
+
+    // the client executables set up their context the same way
+    context->cya_ctx = client_context_new( config->cipher_list, config->verify, 0 );
+    if( context->cya_ctx == 0 )
+    {
+        free( context );
+        return 0;
+    }
+
+    context->send_high_water = config->send_high_water > 0 ? config->send_high_water : NBTLS_SEND_HIGH_WATER;
+
+    return context;
+}
+
+void nbtls_context_free( NbTlsContext_t* context )
+{
+    if( context == 0 ) { return; }
+
+    CyaSSL_CTX_free( context->cya_ctx );
+    free( context );
+}
+
+NbTlsConn_t* nbtls_conn_new( NbTlsContext_t* context, const struct sockaddr_in* endpoint )
+{
+    assert( context != 0 && endpoint != 0 && "Context and endpoint must not be null!" );
+
+    NbTlsConn_t* conn = calloc( 1, sizeof( NbTlsConn_t ) );
+    if( conn == 0 ) { return 0; }
+
+    CORO_CTX_INIT( conn );
+    conn->context               = context;
+    conn->phase                 = NBTLS_CONNECTING;
+    conn->interest              = NBTLS_WANT_NONE;
+    conn->conn.endpoint_addr    = *endpoint;
+
+    send_queue_init( &conn->send_queue, context->send_high_water );
+
+    conn->conn.sock_fd = create_non_blocking_socket();
+    if( conn->conn.sock_fd < 0 )
+    {
+        free( conn );
+        return 0;
+    }
+
+    if( apply_socket_profile( conn->conn.sock_fd, &context->socket_profile ) < 0 )
+    {
+        error_fmt( "socket profile could not be applied: %s", strerror( errno ) );
+        close( conn->conn.sock_fd );
+        free( conn );
+        return 0;
+    }
+
+    conn->cya_obj = create_cyassl_object( context->cya_ctx, &conn->conn );
+    if( conn->cya_obj == 0 )
+    {
+        close( conn->conn.sock_fd );
+        tls_arena_release( &conn->conn.arena );
+        free( conn );
+        return 0;
+    }
+
+    set_cyassl_flags( conn->cya_obj );
+
+    return conn;
+}
+
+void nbtls_conn_free( NbTlsConn_t* conn )
+{
+    if( conn == 0 ) { return; }
+
+    closeSSL( conn->cya_obj, &conn->conn );
+    send_queue_clear( &conn->send_queue );
+    free( conn );
+}
+
+int nbtls_conn_fd( const NbTlsConn_t* conn )
+{
+    assert( conn != 0 && "Connection must not be null!" );
+
+    return conn->conn.sock_fd;
+}
+
+nbtls_interest_t nbtls_conn_interest( const NbTlsConn_t* conn )
+{
+    assert( conn != 0 && "Connection must not be null!" );
+
+    return conn->interest;
+}
+
+/**
+ * \brief   Turns the error of a CyaSSL call into the interest of the
+ *          connection
+ * \return  NBTLS_AGAIN if the socket has to become ready, NBTLS_ERROR other way
+ */
+inline static long nbtls_conn_would_block( NbTlsConn_t* conn, int ret )
+{
+    switch( CyaSSL_get_error( conn->cya_obj, ret ) )
+    {
+        case SSL_ERROR_WANT_READ:
+            conn->interest = NBTLS_WANT_READ;
+            return NBTLS_AGAIN;
+        case SSL_ERROR_WANT_WRITE:
+            conn->interest = NBTLS_WANT_WRITE;
+            return NBTLS_AGAIN;
+        default:
+            conn->interest = NBTLS_WANT_NONE;
+            return NBTLS_ERROR;
+    }
+}
+
+/**
+ * \brief   Pushes out the staged records, a connection never waits for the
+ *          peer while it still holds records the peer did not get
+ * \return  1 if nothing is left staged, 0 if the socket is full, <0 on error
+ */
+inline static int nbtls_conn_flush( NbTlsConn_t* conn )
+{
+    int flushed = conn_output_flush( &conn->conn );
+
+    if( flushed == 0 ) { conn->interest = NBTLS_WANT_WRITE; }
+
+    return flushed;
+}
+
+/**
+ * \brief   Writes the queue out in order until CyaSSL has taken all of it
+ * \return  0 if the queue is empty, NBTLS_AGAIN or NBTLS_ERROR
+ */
+inline static long nbtls_conn_drain( NbTlsConn_t* conn )
+{
+    while( !send_queue_empty( &conn->send_queue ) )
+    {
+        int state = 0;
+
+        int ret = send_queue_write( &conn->send_queue, conn->cya_obj, &state );
+
+        if( ret <= 0 ) { return nbtls_conn_would_block( conn, ret ); }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief   Connect and handshake, every yield returns the phase the
+ *          connection waits in with the interest set
+ */
+static nbtls_state_t nbtls_conn_handshake( NbTlsConn_t* conn )
+{
+    int connected = 0;
+
+    BEGIN_CORO_CTX( conn )
+
+    conn->state = SSL_SUCCESS;
+
+    // with fast open there is no connect, the ClientHello rides on the SYN
+    connected = conn_connect_start( &conn->conn, conn->context->socket_profile.fast_open );
+
+    if( connected == 0 )
+    {
+        conn->interest = NBTLS_WANT_WRITE;
+        YIELD_CTX( conn, NBTLS_CONNECTING );
+
+        connected = conn_connect_finish( &conn->conn );
+    }
+
+    if( connected < 0 )
+    {
+        debug_fmt( "Error while connecting %s", strerror( errno ) );
+        EXIT_CTX( conn, NBTLS_FAILED );
+    }
+
+    conn->phase = NBTLS_HANDSHAKING;
+
+    do
+    {
+        if( conn->state == SSL_ERROR_WANT_READ )
+        {
+            conn->interest = NBTLS_WANT_READ;
+            YIELD_CTX( conn, NBTLS_HANDSHAKING );
+        }
+
+        if( conn->state == SSL_ERROR_WANT_WRITE )
+        {
+            conn->interest = NBTLS_WANT_WRITE;
+            YIELD_CTX( conn, NBTLS_HANDSHAKING );
+        }
+
+        conn->state = tls_connect_step( conn->cya_obj, &conn->conn.arena );
+        debug_fmt( "Connecting SSL state [%d]", conn->state );
+
+    } while( conn->state == SSL_ERROR_WANT_READ || conn->state == SSL_ERROR_WANT_WRITE );
+
+    if( conn->state != SSL_SUCCESS ) { EXIT_CTX( conn, NBTLS_FAILED ); }
+
+    conn->interest = NBTLS_WANT_NONE;
+
+    EXIT_CTX( conn, NBTLS_ESTABLISHED );
+
+    END_CORO()
+
+    return NBTLS_FAILED;
+}
+
+nbtls_state_t nbtls_conn_step( NbTlsConn_t* conn )
+{
+    assert( conn != 0 && "Connection must not be null!" );
+
+    // once the coroutine is over it must not start from the beginning again
+    if( conn->phase == NBTLS_CONNECTING || conn->phase == NBTLS_HANDSHAKING )
+    {
+        conn->phase = nbtls_conn_handshake( conn );
+    }
+
+    if( conn->phase == NBTLS_FAILED )
+    {
+        conn->interest = NBTLS_WANT_NONE;
+        return conn->phase;
+    }
+
+    long drained = conn->phase == NBTLS_ESTABLISHED ? nbtls_conn_drain( conn ) : 0;
+
+    // whatever the connection waits for, the peer gets the staged records first
+    int flushed = drained != NBTLS_ERROR ? nbtls_conn_flush( conn ) : -1;
+
+    if( flushed < 0 )
+    {
+        conn->phase     = NBTLS_FAILED;
+        conn->interest  = NBTLS_WANT_NONE;
+    }
+    else if( flushed > 0 && drained == 0 && conn->phase == NBTLS_ESTABLISHED )
+    {
+        conn->interest  = NBTLS_WANT_NONE;
+    }
+
+    return conn->phase;
+}
+
+long nbtls_conn_submit( NbTlsConn_t* conn, const void* data, size_t size )
+{
+    assert( conn != 0 && data != 0 && "Connection and data must not be null!" );
+    assert( conn->phase == NBTLS_ESTABLISHED && "Connection must be established!" );
+
+    if( size == 0 ) { return 0; }
+
+    // the queued messages go out first, a queue that cannot drain now leaves
+    // the interest set so the caller knows what to wait for
+    long drained = nbtls_conn_drain( conn );
+    if( drained != 0 ) { return drained; }
+
+    // after the handshake CyaSSL frees what it allocates, the pools take it back
+    int ret = CyaSSL_write( conn->cya_obj, data, size > INT32_MAX ? INT32_MAX : ( int ) size );
+
+    if( ret <= 0 ) { return nbtls_conn_would_block( conn, ret ); }
+
+    conn->interest = NBTLS_WANT_NONE;
+
+    // the records are accepted, only the socket is behind, step pushes them out
+    if( nbtls_conn_flush( conn ) < 0 ) { return NBTLS_ERROR; }
+
+    return ret;
+}
+
+int nbtls_conn_queue( NbTlsConn_t* conn, const void* data, size_t size )
+{
+    assert( conn != 0 && ( data != 0 || size == 0 ) && "Connection and data must not be null!" );
+
+    int queued = send_queue_push( &conn->send_queue, ( const char* ) data, size, 1 );
+
+    return queued > 0 ? 1 : queued == 0 ? NBTLS_AGAIN : NBTLS_ERROR;
+}
+
+size_t nbtls_conn_queued( const NbTlsConn_t* conn )
+{
+    assert( conn != 0 && "Connection must not be null!" );
+
+    return conn->send_queue.bytes;
+}
+
+long nbtls_conn_receive( NbTlsConn_t* conn, void* buffer, size_t size )
+{
+    assert( conn != 0 && buffer != 0 && "Connection and buffer must not be null!" );
+    assert( conn->phase == NBTLS_ESTABLISHED && "Connection must be established!" );
+
+    int ret = CyaSSL_read( conn->cya_obj, buffer, size > INT32_MAX ? INT32_MAX : ( int ) size );
+
+    if( ret > 0 )
+    {
+        conn->interest = NBTLS_WANT_NONE;
+        return ret;
+    }
+
+    if( CyaSSL_get_error( conn->cya_obj, ret ) == SSL_ERROR_ZERO_RETURN )
+    {
+        conn->interest = NBTLS_WANT_NONE;
+        return 0;
+    }
+
+    return nbtls_conn_would_block( conn, ret );
+}
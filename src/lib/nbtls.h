@@ -0,0 +1,149 @@
+#ifndef __NBTLS_H__
+#define __NBTLS_H__
+
+#include <stddef.h>
+
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Non-blocking TLS client connections for an event loop owned by the
+ * caller. The library never waits and starts no thread, every connection
+ * tells which fd it lives on and whether it waits for readability or
+ * writability, the caller steps it once the fd is ready.
+ *
+ * The internals (allocator hooks, logging, CyaSSL) are compiled into the
+ * library only, applications include nothing but this header. The
+ * allocator hooks replace the allocator of CyaSSL for the whole process,
+ * they are only installed when nbtls_init is asked to.
+ */
+
+typedef struct nbtls_context    NbTlsContext_t;
+typedef struct nbtls_conn       NbTlsConn_t;
+
+/**
+ * \brief What a connection waits for before it can make progress
+ */
+typedef enum nbtls_interest
+{
+    NBTLS_WANT_NONE = 0,
+    NBTLS_WANT_READ,
+    NBTLS_WANT_WRITE
+} nbtls_interest_t;
+
+/**
+ * \brief Where a connection is, nbtls_conn_step moves it forward
+ */
+typedef enum nbtls_state
+{
+    NBTLS_CONNECTING = 0,
+    NBTLS_HANDSHAKING,
+    NBTLS_ESTABLISHED,
+    NBTLS_FAILED
+} nbtls_state_t;
+
+// results of nbtls_conn_submit and nbtls_conn_receive besides byte counts
+#define NBTLS_AGAIN     ( -1 )
+#define NBTLS_ERROR     ( -2 )
+
+// default bound of the bytes nbtls_conn_queue holds per connection
+#define NBTLS_SEND_HIGH_WATER   ( 256 * 1024 )
+
+/**
+ * \struct NbTlsConfig_t
+ * \brief  Settings shared by the connections of a context, zero is default
+ */
+typedef struct
+{
+    const char* verify;             // PEM with the trust anchors or "embedded", 0 does not verify
+    const char* cipher_list;        // suites in order of preference separated by ':'
+    const char* socket_profile;     // e.g. "nodelay,quickack,sndbuf=262144,fastopen"
+    size_t      send_high_water;    // bytes queued per connection, 0 is NBTLS_SEND_HIGH_WATER
+} NbTlsConfig_t;
+
+/**
+ * \brief   Initializes CyaSSL for the process, pooled_allocator installs
+ *          the process global hooks that serve it from per-connection arenas
+ *          and per-thread pools, 0 leaves the allocator of CyaSSL untouched
+ * \return  1 if successfull <0 other way
+ */
+int nbtls_init( int pooled_allocator );
+
+/**
+ * \brief   Releases what nbtls_init set up, every context must be freed
+ */
+void nbtls_cleanup( void );
+
+/**
+ * \return  context if successfull 0 other way
+ */
+NbTlsContext_t* nbtls_context_new( const NbTlsConfig_t* config );
+
+void nbtls_context_free( NbTlsContext_t* context );
+
+/**
+ * \brief   Creates the socket of a new connection, nothing is sent until
+ *          the first nbtls_conn_step
+ * \return  connection if successfull 0 other way
+ */
+NbTlsConn_t* nbtls_conn_new( NbTlsContext_t* context, const struct sockaddr_in* endpoint );
+
+/**
+ * \brief   Closes the socket and frees the connection
+ */
+void nbtls_conn_free( NbTlsConn_t* conn );
+
+/**
+ * \return  fd to register with the event loop, it stays the same for the
+ *          whole life of the connection
+ */
+int nbtls_conn_fd( const NbTlsConn_t* conn );
+
+/**
+ * \return  what the last step, submit or receive waits for
+ */
+nbtls_interest_t nbtls_conn_interest( const NbTlsConn_t* conn );
+
+/**
+ * \brief   Connects and handshakes as far as the socket allows, on an
+ *          established connection it writes the queued messages and
+ *          pushes out what is still staged
+ * \return  state of the connection
+ */
+nbtls_state_t nbtls_conn_step( NbTlsConn_t* conn );
+
+/**
+ * \brief   Encrypts and sends data, after NBTLS_AGAIN it has to be called
+ *          again with the same data once the interest is met, while
+ *          messages are queued it waits for them
+ * \return  bytes sent, NBTLS_AGAIN or NBTLS_ERROR
+ */
+long nbtls_conn_submit( NbTlsConn_t* conn, const void* data, size_t size );
+
+/**
+ * \brief   Queues a copy of the message behind the ones already queued, it
+ *          is written by the following nbtls_conn_step calls, partial
+ *          writes and retries are taken care of
+ * \return  1 if queued, NBTLS_AGAIN above the high-water mark, NBTLS_ERROR
+ */
+int nbtls_conn_queue( NbTlsConn_t* conn, const void* data, size_t size );
+
+/**
+ * \return  bytes queued that CyaSSL has not taken yet
+ */
+size_t nbtls_conn_queued( const NbTlsConn_t* conn );
+
+/**
+ * \brief   Reads decrypted data
+ * \return  bytes read, 0 when the peer closed, NBTLS_AGAIN or NBTLS_ERROR
+ */
+long nbtls_conn_receive( NbTlsConn_t* conn, void* buffer, size_t size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __NBTLS_H__
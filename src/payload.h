@@ -0,0 +1,129 @@
+#ifndef __PAYLOAD_H__
+#define __PAYLOAD_H__
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * \struct Payload_t
+ * \brief  Read-only request payload mapped straight from its file, every
+ *          connection sending it points into the same pages
+ */
+typedef struct
+{
+    const char* data;
+    size_t      size;
+    void*       mapping;
+} Payload_t;
+
+/**
+ * \brief   Maps the file read-only, nothing is read or copied up front,
+ *          the pages come from the page cache on first use
+ * \return  1 if successfull <0 other way
+ */
+inline static int payload_map( Payload_t* payload, const char* filename )
+{
+    assert( payload != 0 && "Payload must not be null!" );
+    assert( filename != 0 && "Filename must not be null!" );
+
+    memset( payload, 0, sizeof( Payload_t ) );
+
+    int fd = open( filename, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 ) { return -1; }
+
+    struct stat st;
+
+    if( fstat( fd, &st ) < 0 || !S_ISREG( st.st_mode ) )
+    {
+        close( fd );
+        return -1;
+    }
+
+    payload->size = ( size_t ) st.st_size;
+
+    // mmap refuses empty mappings, an empty payload needs none anyway
+    if( payload->size == 0 )
+    {
+        close( fd );
+        payload->data = "";
+        return 1;
+    }
+
+    void* mapping = mmap( 0, payload->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+    // the mapping keeps its own reference to the file
+    close( fd );
+
+    if( mapping == MAP_FAILED ) { return -1; }
+
+    // every connection walks the payload front to back
+    madvise( mapping, payload->size, MADV_SEQUENTIAL );
+
+    payload->mapping    = mapping;
+    payload->data       = ( const char* ) mapping;
+
+    return 1;
+}
+
+inline static void payload_unmap( Payload_t* payload )
+{
+    assert( payload != 0 && "Payload must not be null!" );
+
+    if( payload->mapping != 0 ) { munmap( payload->mapping, payload->size ); }
+
+    memset( payload, 0, sizeof( Payload_t ) );
+}
+
+/**
+ * \brief   Producer of a streamed body, fills buf with at most size bytes
+ *          starting at offset, it is shared by all connections so it must
+ *          not keep per-connection state
+ * \return  number of bytes produced, 0 at the end of the body, <0 on error
+ */
+typedef ssize_t ( *body_producer_t )( void* user, char* buf, size_t size, size_t offset );
+
+/**
+ * \struct BodySource_t
+ * \brief  Body that is pulled chunk by chunk while it is being sent, so an
+ *          upload needs a single chunk buffer whatever the body size is
+ */
+typedef struct
+{
+    body_producer_t     produce;
+    void*               user;
+} BodySource_t;
+
+/**
+ * \brief   Producer reading the body from a file descriptor, pread keeps no
+ *          file position so one descriptor serves every connection
+ */
+inline static ssize_t body_produce_fd( void* user, char* buf, size_t size, size_t offset )
+{
+    int fd = ( int ) ( intptr_t ) user;
+
+    for( ; ; )
+    {
+        ssize_t ret = pread( fd, buf, size, ( off_t ) offset );
+
+        if( ret < 0 && errno == EINTR ) continue;
+
+        return ret;
+    }
+}
+
+inline static void body_source_from_fd( BodySource_t* body, int fd )
+{
+    assert( body != 0 && fd >= 0 && "Body must not be null and fd must be valid!" );
+
+    body->produce   = body_produce_fd;
+    body->user      = ( void* ) ( intptr_t ) fd;
+}
+
+#endif // __PAYLOAD_H__
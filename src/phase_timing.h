@@ -0,0 +1,106 @@
+#ifndef __PHASE_TIMING_H__
+#define __PHASE_TIMING_H__
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "histogram.h"
+
+/**
+ * \brief Phases of a connection as seen by main_handle
+ */
+typedef enum phase
+{
+    PHASE_CONNECT   = 0,
+    PHASE_HANDSHAKE,
+    PHASE_SEND,
+    PHASE_RECEIVE,
+    PHASE_COUNT
+} phase_t;
+
+static const char* const phase_names[ PHASE_COUNT ] =
+{
+      "connect"
+    , "handshake"
+    , "send"
+    , "receive"
+};
+
+/**
+ * \struct PhaseHistograms_t
+ * \brief  One latency histogram per phase, values are in microseconds
+ */
+typedef struct
+{
+    Histogram_t     histograms[ PHASE_COUNT ];
+} PhaseHistograms_t;
+
+inline static void phase_histograms_init( PhaseHistograms_t* phases )
+{
+    assert( phases != 0 && "Phase histograms must not be null!" );
+
+    for( int i = 0; i < PHASE_COUNT; ++i )
+    {
+        histogram_init( &phases->histograms[ i ] );
+    }
+}
+
+inline static void phase_histograms_merge( PhaseHistograms_t* dst, const PhaseHistograms_t* src )
+{
+    assert( dst != 0 && src != 0 && "Phase histograms must not be null!" );
+
+    for( int i = 0; i < PHASE_COUNT; ++i )
+    {
+        histogram_merge( &dst->histograms[ i ], &src->histograms[ i ] );
+    }
+}
+
+inline static void phase_histograms_print( const PhaseHistograms_t* phases )
+{
+    assert( phases != 0 && "Phase histograms must not be null!" );
+
+    for( int i = 0; i < PHASE_COUNT; ++i )
+    {
+        histogram_print( &phases->histograms[ i ], phase_names[ i ], "us" );
+    }
+}
+
+#ifndef NO_PHASE_TIMING
+
+/**
+ * \brief   Starts timing the first phase
+ */
+inline static void phase_begin( struct timespec* phase_start )
+{
+    clock_gettime( CLOCK_MONOTONIC, phase_start );
+}
+
+/**
+ * \brief   Records the phase that just finished and starts the next one,
+ *          a transition costs a single clock read
+ */
+inline static void phase_transition(
+                          PhaseHistograms_t*    phases
+                        , struct timespec*      phase_start
+                        , phase_t               finished )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    long long us = ( now.tv_sec - phase_start->tv_sec ) * 1000000LL + ( now.tv_nsec - phase_start->tv_nsec ) / 1000;
+
+    histogram_record( &phases->histograms[ finished ], us > 0 ? ( uint64_t ) us : 0 );
+
+    *phase_start = now;
+}
+
+#else
+
+// timing compiled out, the histograms simply stay empty
+#define phase_begin( phase_start )                          ( ( void ) ( phase_start ) )
+#define phase_transition( phases, phase_start, finished )   ( ( void ) ( phases ), ( void ) ( phase_start ) )
+
+#endif // NO_PHASE_TIMING
+
+#endif // __PHASE_TIMING_H__
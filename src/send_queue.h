@@ -0,0 +1,171 @@
+#ifndef __SEND_QUEUE_H__
+#define __SEND_QUEUE_H__
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cyassl/ssl.h>
+
+/**
+ * \struct SendBuffer_t
+ * \brief  One outbound message, a copied message keeps its bytes right
+ *          behind the node so they never move until they are written
+ */
+typedef struct send_buffer
+{
+    struct send_buffer* next;
+    const char*         data;
+    size_t              size;
+    size_t              sent;
+} SendBuffer_t;
+
+/**
+ * \struct SendQueue_t
+ * \brief  FIFO of the messages of one connection, only the head is ever
+ *          written, bytes counts what CyaSSL has not taken yet
+ */
+typedef struct
+{
+    SendBuffer_t*       head;
+    SendBuffer_t*       tail;
+    size_t              count;
+    size_t              bytes;
+    size_t              high_water;
+    size_t              retry_size;
+    unsigned long long  completed;
+} SendQueue_t;
+
+/**
+ * \brief   high_water bounds the queued bytes, 0 leaves the queue unbounded
+ */
+inline static void send_queue_init( SendQueue_t* queue, size_t high_water )
+{
+    assert( queue != 0 && "Queue must not be null!" );
+
+    memset( queue, 0, sizeof( SendQueue_t ) );
+    queue->high_water = high_water;
+}
+
+inline static int send_queue_empty( const SendQueue_t* queue )
+{
+    return queue->head == 0;
+}
+
+/**
+ * \return  1 if producers have to wait for the queue to drain 0 other way
+ */
+inline static int send_queue_full( const SendQueue_t* queue )
+{
+    return queue->high_water > 0 && queue->bytes >= queue->high_water;
+}
+
+/**
+ * \brief   Appends a message, a borrowed one (copy 0) has to stay untouched
+ *          until it leaves the queue, a message bigger than the high-water
+ *          mark is still taken by an empty queue
+ * \return  1 if queued, 0 if it would go above the high-water mark, <0 on error
+ */
+inline static int send_queue_push( SendQueue_t* queue, const char* data, size_t size, int copy )
+{
+    assert( queue != 0 && ( data != 0 || size == 0 ) && "Queue and data must not be null!" );
+
+    if( size == 0 ) { return 1; }
+
+    if( queue->high_water > 0 && queue->head != 0 && queue->bytes + size > queue->high_water ) { return 0; }
+
+    SendBuffer_t* buffer = malloc( sizeof( SendBuffer_t ) + ( copy ? size : 0 ) );
+    if( buffer == 0 ) { return -1; }
+
+    if( copy )
+    {
+        memcpy( buffer + 1, data, size );
+        data = ( const char* ) ( buffer + 1 );
+    }
+
+    buffer->next    = 0;
+    buffer->data    = data;
+    buffer->size    = size;
+    buffer->sent    = 0;
+
+    if( queue->tail != 0 )  { queue->tail->next = buffer; }
+    else                    { queue->head = buffer; }
+
+    queue->tail     = buffer;
+    queue->bytes    += size;
+    ++queue->count;
+
+    return 1;
+}
+
+inline static void send_queue_pop( SendQueue_t* queue )
+{
+    SendBuffer_t* buffer = queue->head;
+
+    queue->head = buffer->next;
+    if( queue->head == 0 ) { queue->tail = 0; }
+
+    queue->bytes -= buffer->size - buffer->sent;
+    --queue->count;
+
+    free( buffer );
+}
+
+/**
+ * \brief   Hands the head message to CyaSSL once, after a WANT_READ or
+ *          WANT_WRITE the next call repeats the very same write, same
+ *          pointer and same size, as CyaSSL requires
+ * \return  bytes taken by CyaSSL, <=0 with the CyaSSL error in state
+ */
+inline static int send_queue_write( SendQueue_t* queue, CYASSL* cya_obj, int* state )
+{
+    assert( queue != 0 && cya_obj != 0 && state != 0 && "Queue, cya_obj and state must not be null!" );
+    assert( queue->head != 0 && "Queue must not be empty!" );
+
+    SendBuffer_t* buffer = queue->head;
+
+    size_t size = queue->retry_size;
+
+    if( size == 0 )
+    {
+        size = buffer->size - buffer->sent;
+        if( size > INT_MAX ) { size = INT_MAX; }
+    }
+
+    int ret = CyaSSL_write( cya_obj, buffer->data + buffer->sent, ( int ) size );
+
+    if( ret <= 0 )
+    {
+        *state              = CyaSSL_get_error( cya_obj, ret );
+        queue->retry_size   = *state == SSL_ERROR_WANT_READ || *state == SSL_ERROR_WANT_WRITE ? size : 0;
+        return ret;
+    }
+
+    *state              = SSL_SUCCESS;
+    queue->retry_size   = 0;
+    buffer->sent        += ( size_t ) ret;
+    queue->bytes        -= ( size_t ) ret;
+
+    if( buffer->sent == buffer->size )
+    {
+        send_queue_pop( queue );
+        ++queue->completed;
+    }
+
+    return ret;
+}
+
+/**
+ * \brief   Drops every message, the high-water mark and the counters stay
+ */
+inline static void send_queue_clear( SendQueue_t* queue )
+{
+    assert( queue != 0 && "Queue must not be null!" );
+
+    while( queue->head != 0 ) { send_queue_pop( queue ); }
+
+    queue->retry_size = 0;
+}
+
+#endif // __SEND_QUEUE_H__
@@ -0,0 +1,576 @@
+// tracing every record would make the server the bottleneck of a benchmark
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL 1
+#endif
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include <netinet/tcp.h>
+
+#include "event_loop.h"
+#include "tls_io.h"
+
+// borrowed from libxively
+#include "xi_coroutine.h"
+
+#define SERVER_REQUEST_BUFFER   8192
+#define SERVER_BACKLOG          1024
+
+/**
+ * \struct ServerConnCtx_t
+ * \brief  Per-connection coroutine context of the server side, the live
+ *          connections of a worker are chained so they can be closed when
+ *          the server stops
+ */
+typedef struct server_conn_ctx
+{
+    struct server_conn_ctx* next;
+    struct server_conn_ctx* prev;
+    short               cs;
+    int                 state;
+    size_t              request_size;
+    size_t              request_end;
+    size_t              body_left;
+    size_t              data_sent;
+    char                request_buffer[ SERVER_REQUEST_BUFFER ];
+    CYASSL*             cya_obj;
+    Conn_t              conn;
+    EventHandle_t       event_handle;
+} ServerConnCtx_t;
+
+/**
+ * \struct ServerWorker_t
+ * \brief  One accepting reactor, every worker owns a SO_REUSEPORT listener
+ *          so the kernel spreads the incoming connections between them
+ */
+typedef struct
+{
+    pthread_t       thread;
+    int             id;
+    int             cpu;
+    int             listen_fd;
+    EventHandle_t   listen_handle;
+    EventLoop_t     event_loop;
+    ServerConnCtx_t* live;
+    CYASSL_CTX*     cya_ctx;
+    const char*     response;
+    size_t          response_size;
+    unsigned long   accepted;
+    unsigned long   handshakes;
+    unsigned long   requests;
+    unsigned long   failed;
+    SendStats_t     sends;
+} ServerWorker_t;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void on_stop_signal( int sig )
+{
+    ( void ) sig;
+    server_stop = 1;
+}
+
+inline static void print_usage( void )
+{
+    printf( "Usage: server [-t threads] [-p] [-s body_size] <port> <cert_file> <key_file>\n" );
+    printf( "  -t   worker threads, each one accepts on its own SO_REUSEPORT listener\n" );
+    printf( "  -p   pin worker threads to cpus\n" );
+    printf( "  -s   size of the canned response body in bytes\n" );
+    printf( "Certificates can be created with make test-certs.\n" );
+}
+
+inline static CYASSL_CTX* init_cyaSSL_server( const char* cert_file, const char* key_file )
+{
+    CyaSSL_Init();
+
+    CYASSL_CTX* cya_ctx = CyaSSL_CTX_new( CyaSSLv23_server_method() );
+    if( cya_ctx == 0 ) { return 0; }
+
+    if( CyaSSL_CTX_use_certificate_file( cya_ctx, cert_file, SSL_FILETYPE_PEM ) != SSL_SUCCESS
+        || CyaSSL_CTX_use_PrivateKey_file( cya_ctx, key_file, SSL_FILETYPE_PEM ) != SSL_SUCCESS )
+    {
+        CyaSSL_CTX_free( cya_ctx );
+        return 0;
+    }
+
+    CyaSSL_SetIORecv( cya_ctx, myPrivateRecv );
+    CyaSSL_SetIOSend( cya_ctx, myPrivateSend );
+
+    return cya_ctx;
+}
+
+inline static int create_listen_socket( int port )
+{
+    int socket_fd = create_non_blocking_socket();
+    if( socket_fd < 0 ) return -1;
+
+    int on = 1;
+    setsockopt( socket_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+    setsockopt( socket_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof( on ) );
+
+    // a client that holds a cookie has its ClientHello taken from the SYN,
+    // whether it happens is up to net.ipv4.tcp_fastopen
+    int fast_open_queue = SERVER_BACKLOG;
+    setsockopt( socket_fd, IPPROTO_TCP, TCP_FASTOPEN, &fast_open_queue, sizeof( fast_open_queue ) );
+
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof( addr ) );
+
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl( INADDR_ANY );
+    addr.sin_port           = htons( port );
+
+    if( bind( socket_fd, ( struct sockaddr* ) &addr, sizeof( addr ) ) < 0
+        || listen( socket_fd, SERVER_BACKLOG ) < 0 )
+    {
+        close( socket_fd );
+        return -1;
+    }
+
+    return socket_fd;
+}
+
+/**
+ * \brief   Finds the end of the request head and the length of the body it
+ *          announces with Content-Length, lone \n line endings are accepted
+ * \return  size of the request head, 0 if more data is needed
+ */
+inline static size_t find_request_head( const char* buffer, size_t size, size_t* content_length )
+{
+    for( size_t i = 0; i + 1 < size; ++i )
+    {
+        size_t head_end = 0;
+
+        if( buffer[ i ] == '\n' && buffer[ i + 1 ] == '\n' )
+        {
+            head_end = i + 2;
+        }
+        else if( i + 3 < size && memcmp( buffer + i, "\r\n\r\n", 4 ) == 0 )
+        {
+            head_end = i + 4;
+        }
+        else
+        {
+            continue;
+        }
+
+        *content_length = 0;
+
+        for( size_t j = 0; j + 15 < head_end; ++j )
+        {
+            if( ( j == 0 || buffer[ j - 1 ] == '\n' ) && strncasecmp( buffer + j, "Content-Length:", 15 ) == 0 )
+            {
+                *content_length = strtoul( buffer + j + 15, 0, 10 );
+                break;
+            }
+        }
+
+        return head_end;
+    }
+
+    return 0;
+}
+
+static int server_handle( ServerConnCtx_t* ctx, ServerWorker_t* worker )
+{
+    assert( ctx != 0 && worker != 0 && "ctx and worker must not be null!" );
+
+    CYASSL* cya_obj = ctx->cya_obj;
+
+    BEGIN_CORO_CTX( ctx )
+
+    ctx->state          = SSL_SUCCESS;
+    ctx->request_size   = 0;
+
+    // part one is the server side of the handshake
+    {
+        do
+        {
+            if( ctx->state == SSL_ERROR_WANT_READ )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_READ );
+            }
+
+            if( ctx->state == SSL_ERROR_WANT_WRITE )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_WRITE );
+            }
+
+            int ret     = CyaSSL_accept( cya_obj );
+            ctx->state  = ret <= 0 ? CyaSSL_get_error( cya_obj, ret ) : SSL_SUCCESS;
+
+        } while( ctx->state == SSL_ERROR_WANT_READ || ctx->state == SSL_ERROR_WANT_WRITE );
+
+        if( ctx->state != SSL_SUCCESS )
+        {
+            EXIT_CTX( ctx, -1 );
+        }
+
+        ++worker->handshakes;
+    }
+
+    // part two answers requests until the client goes away
+    for( ; ; )
+    {
+        // read until a complete request head is buffered
+        while( ( ctx->request_end = find_request_head( ctx->request_buffer, ctx->request_size, &ctx->body_left ) ) == 0 )
+        {
+            if( ctx->request_size == sizeof( ctx->request_buffer ) )
+            {
+                debug_log( "Request does not fit into the buffer" );
+                EXIT_CTX( ctx, -1 );
+            }
+
+            int ret     = CyaSSL_read( cya_obj, ctx->request_buffer + ctx->request_size, sizeof( ctx->request_buffer ) - ctx->request_size );
+            ctx->state  = ret <= 0 ? CyaSSL_get_error( cya_obj, ret ) : SSL_SUCCESS;
+
+            if( ret > 0 )
+            {
+                ctx->request_size += ret;
+            }
+            else if( ctx->state == SSL_ERROR_WANT_READ )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_READ );
+            }
+            else if( ctx->state == SSL_ERROR_WANT_WRITE )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_WRITE );
+            }
+            else if( ctx->state == SSL_ERROR_ZERO_RETURN || ctx->request_size == 0 )
+            {
+                // closed between requests
+                RESTART_CTX( ctx, 0 );
+            }
+            else
+            {
+                EXIT_CTX( ctx, -1 );
+            }
+        }
+
+        // the part of the body that came along with the head
+        {
+            size_t buffered = ctx->request_size - ctx->request_end;
+            if( buffered > ctx->body_left ) { buffered = ctx->body_left; }
+
+            ctx->request_end    += buffered;
+            ctx->body_left      -= buffered;
+        }
+
+        // the rest of the body is read and dropped, never more than it announced
+        // so nothing pipelined behind it is lost, an upload of any size fits
+        if( ctx->body_left > 0 )
+        {
+            ctx->request_size   = 0;
+            ctx->request_end    = 0;
+
+            while( ctx->body_left > 0 )
+            {
+                size_t wanted = ctx->body_left < sizeof( ctx->request_buffer ) ? ctx->body_left : sizeof( ctx->request_buffer );
+
+                int ret     = CyaSSL_read( cya_obj, ctx->request_buffer, wanted );
+                ctx->state  = ret <= 0 ? CyaSSL_get_error( cya_obj, ret ) : SSL_SUCCESS;
+
+                if( ret > 0 )
+                {
+                    ctx->body_left -= ret;
+                }
+                else if( ctx->state == SSL_ERROR_WANT_READ )
+                {
+                    YIELD_CTX( ctx, ( int ) WANT_READ );
+                }
+                else if( ctx->state == SSL_ERROR_WANT_WRITE )
+                {
+                    YIELD_CTX( ctx, ( int ) WANT_WRITE );
+                }
+                else
+                {
+                    EXIT_CTX( ctx, -1 );
+                }
+            }
+        }
+
+        // answer with the canned response, a retried write must use the same buffer
+        ctx->data_sent = 0;
+
+        while( ctx->data_sent < worker->response_size )
+        {
+            int ret     = CyaSSL_write( cya_obj, worker->response + ctx->data_sent, worker->response_size - ctx->data_sent );
+            ctx->state  = ret <= 0 ? CyaSSL_get_error( cya_obj, ret ) : SSL_SUCCESS;
+
+            if( ret > 0 )
+            {
+                ctx->data_sent += ret;
+            }
+            else if( ctx->state == SSL_ERROR_WANT_READ )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_READ );
+            }
+            else if( ctx->state == SSL_ERROR_WANT_WRITE )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_WRITE );
+            }
+            else
+            {
+                EXIT_CTX( ctx, -1 );
+            }
+        }
+
+        ++worker->requests;
+
+        // keep whatever the client already pipelined behind this request
+        memmove( ctx->request_buffer, ctx->request_buffer + ctx->request_end, ctx->request_size - ctx->request_end );
+        ctx->request_size -= ctx->request_end;
+    }
+
+    END_CORO()
+
+    return -1;
+}
+
+inline static void server_conn_close( ServerWorker_t* worker, ServerConnCtx_t* ctx )
+{
+    event_loop_unwatch( &worker->event_loop, &ctx->event_handle );
+    closeSSL( ctx->cya_obj, &ctx->conn );
+
+    if( ctx->prev != 0 )    { ctx->prev->next = ctx->next; }
+    else                    { worker->live = ctx->next; }
+
+    if( ctx->next != 0 )    { ctx->next->prev = ctx->prev; }
+
+    free( ctx );
+}
+
+inline static void server_conn_resume( ServerWorker_t* worker, ServerConnCtx_t* ctx )
+{
+    int ret = server_handle( ctx, worker );
+
+    // staged records go out before waiting, a full socket is waited for first
+    if( ret > 0 )
+    {
+        int flushed = conn_output_flush( &ctx->conn );
+        if( flushed < 0 )           { ret = -1; }
+        else if( flushed == 0 )     { ret = WANT_WRITE; }
+    }
+
+    if( ret > 0 && event_loop_watch( &worker->event_loop, &ctx->event_handle, ( wanted_event_t ) ret, ctx ) > 0 )
+    {
+        return;
+    }
+
+    if( ret != 0 ) { ++worker->failed; }
+
+    server_conn_close( worker, ctx );
+}
+
+inline static void server_accept( ServerWorker_t* worker )
+{
+    for( ; ; )
+    {
+        ServerConnCtx_t* ctx    = 0;
+        int fd                  = accept4( worker->listen_fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+        if( fd < 0 )
+        {
+            if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+            {
+                error_fmt( "accept failed: %s", strerror( errno ) );
+            }
+
+            return;
+        }
+
+        int on = 1;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+
+        ctx = calloc( 1, sizeof( ServerConnCtx_t ) );
+        if( ctx == 0 ) { close( fd ); continue; }
+
+        CORO_CTX_INIT( ctx );
+        ctx->conn.sock_fd       = fd;
+        ctx->event_handle.fd    = fd;
+        ctx->cya_obj            = create_cyassl_object( worker->cya_ctx, &ctx->conn );
+
+        if( ctx->cya_obj == 0 )
+        {
+            close( fd );
+            free( ctx );
+            ++worker->failed;
+            continue;
+        }
+
+        set_cyassl_flags( ctx->cya_obj );
+
+        ctx->next = worker->live;
+        if( worker->live != 0 ) { worker->live->prev = ctx; }
+        worker->live = ctx;
+
+        ++worker->accepted;
+
+        server_conn_resume( worker, ctx );
+    }
+}
+
+static void* server_worker_run( void* arg )
+{
+    ServerWorker_t* worker = ( ServerWorker_t* ) arg;
+
+    if( worker->cpu >= 0 ) { pin_thread( worker->id, worker->cpu ); }
+
+    if( event_loop_watch( &worker->event_loop, &worker->listen_handle, WANT_READ, 0 ) < 0 )
+    {
+        DIE( "Could not watch the listening socket!", 0 );
+    }
+
+    while( !server_stop )
+    {
+        // short timeout so a stop request is noticed
+        int e_ret = event_loop_wait( &worker->event_loop, 500 );
+
+        if( e_ret < 0 && errno == EINTR ) continue;
+        if( e_ret < 0 ) DIE( "error on epoll_wait...", 0 );
+
+        for( int i = 0; i < e_ret; ++i )
+        {
+            ServerConnCtx_t* ctx = ( ServerConnCtx_t* ) event_loop_data( &worker->event_loop, i );
+
+            // the listener is registered without data
+            if( ctx == 0 )  { server_accept( worker ); }
+            else            { server_conn_resume( worker, ctx ); }
+        }
+    }
+
+    // connections still open when the server stops are closed here
+    while( worker->live != 0 ) { server_conn_close( worker, worker->live ); }
+
+    worker->sends = tls_io_send_stats;
+
+    return 0;
+}
+
+/**
+ * \main
+ */
+int main( const int argc, char* const* argv )
+{
+    debug_init();
+
+    int threads         = 1;
+    int pin             = 0;
+    long body_size      = 64;
+    int opt             = 0;
+
+    while( ( opt = getopt( argc, argv, "t:ps:" ) ) != -1 )
+    {
+        switch( opt )
+        {
+            case 't':
+                threads = atoi( optarg );
+                break;
+            case 'p':
+                pin = 1;
+                break;
+            case 's':
+                body_size = atol( optarg );
+                break;
+            default:
+                print_usage();
+                exit( 1 );
+        }
+    }
+
+    if( argc - optind != 3 || threads <= 0 || body_size < 0 )
+    {
+        print_usage();
+        exit( 1 );
+    }
+
+    const int port          = atoi( argv[ optind ] );
+    const char* cert_file   = argv[ optind + 1 ];
+    const char* key_file    = argv[ optind + 2 ];
+
+    signal( SIGPIPE, SIG_IGN );
+    signal( SIGINT, on_stop_signal );
+    signal( SIGTERM, on_stop_signal );
+
+    CYASSL_CTX* cyaSSLContext = init_cyaSSL_server( cert_file, key_file );
+    if( cyaSSLContext == 0 ) DIE( "CyaSSL server initialization fault...", 0 );
+
+    // the canned response is built once and shared by every connection
+    char header[ 128 ];
+    int header_size = snprintf( header, sizeof( header )
+        , "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %ld\r\n\r\n", body_size );
+
+    size_t response_size    = ( size_t ) header_size + ( size_t ) body_size;
+    char* response          = malloc( response_size );
+    if( response == 0 ) DIE( "Could not allocate the response!", 0 );
+
+    memcpy( response, header, header_size );
+    memset( response + header_size, 'x', body_size );
+
+    ServerWorker_t* workers = calloc( threads, sizeof( ServerWorker_t ) );
+    if( workers == 0 ) DIE( "Could not allocate workers!", 0 );
+
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+
+    for( int i = 0; i < threads; ++i )
+    {
+        ServerWorker_t* worker  = &workers[ i ];
+
+        worker->id              = i;
+        worker->cpu             = pin && cpus > 0 ? ( int ) ( i % cpus ) : -1;
+        worker->cya_ctx         = cyaSSLContext;
+        worker->response        = response;
+        worker->response_size   = response_size;
+        worker->listen_fd       = create_listen_socket( port );
+
+        if( worker->listen_fd < 0 ) DIE( "Could not listen on the given port!", 0 );
+
+        worker->listen_handle.fd = worker->listen_fd;
+
+        if( event_loop_init( &worker->event_loop, EVENT_LOOP_MAX_EVENTS ) < 0 ) DIE( "Event loop initialization failed!", 0 );
+    }
+
+    printf( "listening on port %d with %d workers\n", port, threads );
+    fflush( stdout );
+
+    for( int i = 1; i < threads; ++i )
+    {
+        if( pthread_create( &workers[ i ].thread, 0, server_worker_run, &workers[ i ] ) != 0 ) DIE( "Could not start worker thread!", 0 );
+    }
+
+    server_worker_run( &workers[ 0 ] );
+
+    unsigned long accepted = 0, handshakes = 0, requests = 0, failed = 0;
+    SendStats_t sends = { 0, 0 };
+
+    for( int i = 0; i < threads; ++i )
+    {
+        if( i > 0 ) { pthread_join( workers[ i ].thread, 0 ); }
+
+        accepted    += workers[ i ].accepted;
+        handshakes  += workers[ i ].handshakes;
+        requests    += workers[ i ].requests;
+        failed      += workers[ i ].failed;
+
+        sends.calls     += workers[ i ].sends.calls;
+        sends.syscalls  += workers[ i ].sends.syscalls;
+
+        event_loop_free( &workers[ i ].event_loop );
+        close( workers[ i ].listen_fd );
+    }
+
+    printf( "accepted %lu, handshakes %lu, requests %lu, failed %lu\n", accepted, handshakes, requests, failed );
+    printf( "sends %llu records in %llu syscalls, %lld saved\n"
+        , sends.calls, sends.syscalls, ( long long ) ( sends.calls - sends.syscalls ) );
+
+    free( workers );
+    free( response );
+
+    CyaSSL_CTX_free( cyaSSLContext );
+    CyaSSL_Cleanup();
+
+    return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef __SESSION_CACHE_H__
+#define __SESSION_CACHE_H__
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <netinet/in.h>
+
+#include <cyassl/ssl.h>
+
+// must be a power of two, entries are direct mapped
+#define SESSION_CACHE_SIZE  256
+
+/**
+ * \struct SessionCacheEntry_t
+ * \brief  One cached session, the key is the endpoint address and port
+ */
+typedef struct
+{
+    struct sockaddr_in  endpoint_addr;
+    CYASSL_SESSION*     session;
+} SessionCacheEntry_t;
+
+/**
+ * \struct SessionCache_t
+ * \brief  Client side TLS session cache keyed by endpoint with the
+ *          statistics needed to judge whether resumption pays off, it is
+ *          shared by all workers and touched once per handshake so a
+ *          single lock is enough
+ */
+typedef struct
+{
+    pthread_mutex_t     lock;
+    SessionCacheEntry_t entries[ SESSION_CACHE_SIZE ];
+
+    unsigned long       hits;
+    unsigned long       misses;
+    unsigned long       full_handshakes;
+    unsigned long       resumed_handshakes;
+    double              full_handshake_ms;
+    double              resumed_handshake_ms;
+} SessionCache_t;
+
+/**
+ * \brief   Initializes the cache
+ * \return  1 if successfull <0 other way
+ */
+inline static int session_cache_init( SessionCache_t* cache )
+{
+    assert( cache != 0 && "Session cache must not be null!" );
+
+    memset( cache, 0, sizeof( SessionCache_t ) );
+
+    return pthread_mutex_init( &cache->lock, 0 ) == 0 ? 1 : -1;
+}
+
+inline static void session_cache_free( SessionCache_t* cache )
+{
+    assert( cache != 0 && "Session cache must not be null!" );
+
+    pthread_mutex_destroy( &cache->lock );
+}
+
+inline static SessionCacheEntry_t* session_cache_slot(
+                          SessionCache_t*               cache
+                        , const struct sockaddr_in*     endpoint_addr )
+{
+    unsigned long hash = ( unsigned long ) endpoint_addr->sin_addr.s_addr * 2654435761UL;
+    hash ^= ( unsigned long ) endpoint_addr->sin_port * 40503UL;
+
+    return &cache->entries[ ( hash ^ ( hash >> 16 ) ) & ( SESSION_CACHE_SIZE - 1 ) ];
+}
+
+inline static int session_cache_key_equal(
+                          const struct sockaddr_in*     a
+                        , const struct sockaddr_in*     b )
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/**
+ * \brief   Looks up the session saved for the endpoint
+ * \return  session if there is one 0 other way
+ */
+inline static CYASSL_SESSION* session_cache_lookup(
+                          SessionCache_t*               cache
+                        , const struct sockaddr_in*     endpoint_addr )
+{
+    assert( cache != 0 && endpoint_addr != 0 && "Session cache and endpoint must not be null!" );
+
+    CYASSL_SESSION* session = 0;
+
+    pthread_mutex_lock( &cache->lock );
+
+    SessionCacheEntry_t* entry = session_cache_slot( cache, endpoint_addr );
+
+    if( entry->session != 0 && session_cache_key_equal( &entry->endpoint_addr, endpoint_addr ) )
+    {
+        session = entry->session;
+        ++cache->hits;
+    }
+    else
+    {
+        ++cache->misses;
+    }
+
+    pthread_mutex_unlock( &cache->lock );
+
+    return session;
+}
+
+/**
+ * \brief   Saves the session of a finished handshake, the session object
+ *          itself is owned by CyaSSL's internal session cache
+ */
+inline static void session_cache_store(
+                          SessionCache_t*               cache
+                        , const struct sockaddr_in*     endpoint_addr
+                        , CYASSL_SESSION*               session )
+{
+    assert( cache != 0 && endpoint_addr != 0 && "Session cache and endpoint must not be null!" );
+
+    if( session == 0 ) { return; }
+
+    pthread_mutex_lock( &cache->lock );
+
+    SessionCacheEntry_t* entry = session_cache_slot( cache, endpoint_addr );
+
+    entry->endpoint_addr    = *endpoint_addr;
+    entry->session          = session;
+
+    pthread_mutex_unlock( &cache->lock );
+}
+
+inline static double session_cache_elapsed_ms( const struct timespec* start )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( now.tv_sec - start->tv_sec ) * 1e3 + ( now.tv_nsec - start->tv_nsec ) / 1e6;
+}
+
+inline static void session_cache_record_handshake(
+                          SessionCache_t*   cache
+                        , int               resumed
+                        , double            elapsed_ms )
+{
+    assert( cache != 0 && "Session cache must not be null!" );
+
+    pthread_mutex_lock( &cache->lock );
+
+    if( resumed )
+    {
+        ++cache->resumed_handshakes;
+        cache->resumed_handshake_ms += elapsed_ms;
+    }
+    else
+    {
+        ++cache->full_handshakes;
+        cache->full_handshake_ms += elapsed_ms;
+    }
+
+    pthread_mutex_unlock( &cache->lock );
+}
+
+inline static void session_cache_print_stats( const SessionCache_t* cache )
+{
+    assert( cache != 0 && "Session cache must not be null!" );
+
+    double full_avg     = cache->full_handshakes ? cache->full_handshake_ms / cache->full_handshakes : 0.0;
+    double resumed_avg  = cache->resumed_handshakes ? cache->resumed_handshake_ms / cache->resumed_handshakes : 0.0;
+
+    printf( "session cache: hits %lu, misses %lu\n", cache->hits, cache->misses );
+    printf( "handshakes: full %lu avg %.3f ms, resumed %lu avg %.3f ms",
+            cache->full_handshakes, full_avg, cache->resumed_handshakes, resumed_avg );
+
+    if( cache->full_handshakes && cache->resumed_handshakes )
+    {
+        printf( ", resumption saves %.3f ms", full_avg - resumed_avg );
+    }
+
+    printf( "\n" );
+}
+
+#endif // __SESSION_CACHE_H__
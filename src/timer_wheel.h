@@ -0,0 +1,294 @@
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// one tick is a millisecond, every level has 2^SLOT_BITS slots so the four
+// levels cover 2^24 ms, that is a bit more than four and a half hours
+#define TIMER_WHEEL_SLOT_BITS   6
+#define TIMER_WHEEL_SLOTS       ( 1 << TIMER_WHEEL_SLOT_BITS )
+#define TIMER_WHEEL_SLOT_MASK   ( TIMER_WHEEL_SLOTS - 1 )
+#define TIMER_WHEEL_LEVELS      4
+#define TIMER_WHEEL_MAX_DELAY   ( ( ( uint64_t ) 1 << ( TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS ) ) - 1 )
+
+/**
+ * \struct Timer_t
+ * \brief  Intrusive timer, embedded in whatever it times out, the lists are
+ *          circular so a timer unlinks itself without knowing its slot
+ */
+typedef struct timer
+{
+    struct timer*   next;
+    struct timer*   prev;
+    uint64_t        expires;
+} Timer_t;
+
+/**
+ * \struct TimerWheel_t
+ * \brief  Hierarchical timing wheel, scheduling and cancelling are O(1),
+ *          timers of the upper levels cascade down as their time comes
+ */
+typedef struct
+{
+    uint64_t    now;
+    size_t      count;
+    Timer_t     slots[ TIMER_WHEEL_LEVELS ][ TIMER_WHEEL_SLOTS ];
+    Timer_t     expired;
+} TimerWheel_t;
+
+inline static uint64_t timer_wheel_clock_ms( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000 + ( uint64_t ) now.tv_nsec / 1000000;
+}
+
+inline static void timer_list_init( Timer_t* head )
+{
+    head->next = head;
+    head->prev = head;
+}
+
+inline static void timer_init( Timer_t* timer )
+{
+    timer_list_init( timer );
+    timer->expires = 0;
+}
+
+inline static int timer_pending( const Timer_t* timer )
+{
+    return timer->next != timer;
+}
+
+inline static void timer_list_push( Timer_t* head, Timer_t* timer )
+{
+    timer->prev         = head->prev;
+    timer->next         = head;
+    head->prev->next    = timer;
+    head->prev          = timer;
+}
+
+inline static void timer_list_unlink( Timer_t* timer )
+{
+    timer->prev->next   = timer->next;
+    timer->next->prev   = timer->prev;
+    timer_list_init( timer );
+}
+
+inline static void timer_wheel_init( TimerWheel_t* wheel, uint64_t now_ms )
+{
+    assert( wheel != 0 && "Wheel must not be null!" );
+
+    wheel->now      = now_ms;
+    wheel->count    = 0;
+
+    for( int level = 0; level < TIMER_WHEEL_LEVELS; ++level )
+    {
+        for( int slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot )
+        {
+            timer_list_init( &wheel->slots[ level ][ slot ] );
+        }
+    }
+
+    timer_list_init( &wheel->expired );
+}
+
+/**
+ * \brief   Puts the timer into the lowest level that can hold its delay
+ */
+inline static void timer_wheel_insert( TimerWheel_t* wheel, Timer_t* timer )
+{
+    uint64_t delay  = timer->expires - wheel->now;
+    int level       = 0;
+
+    while( level < TIMER_WHEEL_LEVELS - 1 && delay >= ( ( uint64_t ) 1 << ( TIMER_WHEEL_SLOT_BITS * ( level + 1 ) ) ) )
+    {
+        ++level;
+    }
+
+    int slot = ( int ) ( ( timer->expires >> ( TIMER_WHEEL_SLOT_BITS * level ) ) & TIMER_WHEEL_SLOT_MASK );
+
+    timer_list_push( &wheel->slots[ level ][ slot ], timer );
+}
+
+/**
+ * \brief   Arms the timer to fire timeout_ms after the current time of the
+ *          wheel, an armed timer is moved
+ */
+inline static void timer_wheel_schedule( TimerWheel_t* wheel, Timer_t* timer, uint64_t timeout_ms )
+{
+    assert( wheel != 0 && timer != 0 && "Wheel and timer must not be null!" );
+
+    if( timer_pending( timer ) ) { timer_list_unlink( timer ); } else { ++wheel->count; }
+
+    if( timeout_ms == 0 )                       { timeout_ms = 1; }
+    if( timeout_ms > TIMER_WHEEL_MAX_DELAY )    { timeout_ms = TIMER_WHEEL_MAX_DELAY; }
+
+    timer->expires = wheel->now + timeout_ms;
+    timer_wheel_insert( wheel, timer );
+}
+
+inline static void timer_wheel_cancel( TimerWheel_t* wheel, Timer_t* timer )
+{
+    assert( wheel != 0 && timer != 0 && "Wheel and timer must not be null!" );
+
+    if( !timer_pending( timer ) ) { return; }
+
+    timer_list_unlink( timer );
+    --wheel->count;
+}
+
+/**
+ * \brief   Re-inserts the timers of an upper level slot, they now fit lower
+ */
+inline static void timer_wheel_cascade( TimerWheel_t* wheel, int level, int slot )
+{
+    Timer_t pending;
+    Timer_t* head = &wheel->slots[ level ][ slot ];
+
+    if( !timer_pending( head ) ) { return; }
+
+    // detach the whole slot first, re-inserting may land in the very same slot
+    pending.next        = head->next;
+    pending.prev        = head->prev;
+    pending.next->prev  = &pending;
+    pending.prev->next  = &pending;
+    timer_list_init( head );
+
+    while( timer_pending( &pending ) )
+    {
+        Timer_t* timer = pending.next;
+        timer_list_unlink( timer );
+        timer_wheel_insert( wheel, timer );
+    }
+}
+
+/**
+ * \brief   First tick after now at which the wheel has anything to do, the
+ *          tick a lowest level timer fires or the start of the next occupied
+ *          slot of an upper level, that is when the slot cascades, at most
+ *          one scan of every level
+ * \return  the tick or UINT64_MAX if no slot is occupied
+ */
+inline static uint64_t timer_wheel_next_tick( const TimerWheel_t* wheel )
+{
+    uint64_t next = UINT64_MAX;
+
+    // lowest level timers are never more than a level ahead of now
+    for( uint64_t tick = wheel->now + 1; tick < wheel->now + TIMER_WHEEL_SLOTS; ++tick )
+    {
+        if( timer_pending( &wheel->slots[ 0 ][ tick & TIMER_WHEEL_SLOT_MASK ] ) )
+        {
+            next = tick;
+            break;
+        }
+    }
+
+    for( int level = 1; level < TIMER_WHEEL_LEVELS; ++level )
+    {
+        const int shift     = TIMER_WHEEL_SLOT_BITS * level;
+        const uint64_t base = ( wheel->now >> shift ) + 1;
+
+        for( uint64_t index = base; index < base + TIMER_WHEEL_SLOTS; ++index )
+        {
+            // a later slot of this level cannot start any earlier
+            if( ( index << shift ) >= next ) { break; }
+
+            if( timer_pending( &wheel->slots[ level ][ index & TIMER_WHEEL_SLOT_MASK ] ) )
+            {
+                next = index << shift;
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+/**
+ * \brief   Moves the wheel forward to now_ms, timers that fire on the way
+ *          are queued for timer_wheel_pop_expired, the wheel jumps from one
+ *          occupied slot to the next so the cost does not grow with the time
+ *          that passed
+ */
+inline static void timer_wheel_advance( TimerWheel_t* wheel, uint64_t now_ms )
+{
+    assert( wheel != 0 && "Wheel must not be null!" );
+
+    while( wheel->now < now_ms )
+    {
+        uint64_t next = wheel->count > 0 ? timer_wheel_next_tick( wheel ) : UINT64_MAX;
+
+        // nothing to do on the way, jump straight there
+        if( next > now_ms )
+        {
+            wheel->now = now_ms;
+            return;
+        }
+
+        wheel->now = next;
+
+        // upper levels drop their next slot one level down every time the
+        // level below wraps around
+        for( int level = 1; level < TIMER_WHEEL_LEVELS; ++level )
+        {
+            if( ( wheel->now & ( ( ( uint64_t ) 1 << ( TIMER_WHEEL_SLOT_BITS * level ) ) - 1 ) ) != 0 ) { break; }
+
+            timer_wheel_cascade( wheel, level, ( int ) ( ( wheel->now >> ( TIMER_WHEEL_SLOT_BITS * level ) ) & TIMER_WHEEL_SLOT_MASK ) );
+        }
+
+        Timer_t* head = &wheel->slots[ 0 ][ wheel->now & TIMER_WHEEL_SLOT_MASK ];
+
+        while( timer_pending( head ) )
+        {
+            Timer_t* timer = head->next;
+            timer_list_unlink( timer );
+            timer_list_push( &wheel->expired, timer );
+        }
+    }
+}
+
+/**
+ * \brief   Takes the next fired timer, rescheduling or cancelling a fired
+ *          timer before it is popped takes it back out of the queue
+ * \return  timer or 0 if none is left
+ */
+inline static Timer_t* timer_wheel_pop_expired( TimerWheel_t* wheel )
+{
+    assert( wheel != 0 && "Wheel must not be null!" );
+
+    if( !timer_pending( &wheel->expired ) ) { return 0; }
+
+    Timer_t* timer = wheel->expired.next;
+    timer_list_unlink( timer );
+    --wheel->count;
+
+    return timer;
+}
+
+/**
+ * \brief   How long the event loop may sleep without missing a timer, an
+ *          upper level timer wakes the loop up when its slot cascades, not
+ *          every time the lowest level wraps around
+ * \return  timeout in milliseconds, never more than max_ms
+ */
+inline static int timer_wheel_next_timeout_ms( const TimerWheel_t* wheel, int max_ms )
+{
+    assert( wheel != 0 && "Wheel must not be null!" );
+
+    if( timer_pending( &wheel->expired ) )  { return 0; }
+    if( wheel->count == 0 )                 { return max_ms; }
+
+    uint64_t next = timer_wheel_next_tick( wheel );
+
+    if( next == UINT64_MAX || next - wheel->now >= ( uint64_t ) max_ms ) { return max_ms; }
+
+    return ( int ) ( next - wheel->now );
+}
+
+#endif // __TIMER_WHEEL_H__
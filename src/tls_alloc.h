@@ -0,0 +1,415 @@
+#ifndef __TLS_ALLOC_H__
+#define __TLS_ALLOC_H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cyassl/ctaocrypt/memory.h>
+
+// size classes are powers of two from 2^MIN_SHIFT up to 2^MAX_SHIFT bytes,
+// anything larger goes straight to the system allocator
+#define TLS_ALLOC_MIN_SHIFT     5
+#define TLS_ALLOC_MAX_SHIFT     14
+#define TLS_ALLOC_CLASSES       ( TLS_ALLOC_MAX_SHIFT - TLS_ALLOC_MIN_SHIFT + 1 )
+
+// arena memory is carved out of chunks of this size, a connection that
+// needs more than TLS_ARENA_MAX falls back to the size-class pools
+#define TLS_ARENA_CHUNK_SIZE    ( 32 * 1024 )
+#define TLS_ARENA_MAX           ( 256 * 1024 )
+// released standard chunks kept per thread for the next connections
+#define TLS_ARENA_SPARE_CHUNKS  64
+
+/**
+ * \brief Where a block came from, kept in front of every block so the free
+ *          hook knows what to do with it
+ */
+typedef enum alloc_origin
+{
+    ALLOC_ORIGIN_SYSTEM = 0,
+    ALLOC_ORIGIN_POOL,
+    ALLOC_ORIGIN_ARENA
+} alloc_origin_t;
+
+/**
+ * \brief How the hooks serve CyaSSL, the system mode only counts
+ */
+typedef enum alloc_mode
+{
+    ALLOC_MODE_SYSTEM   = 0,
+    ALLOC_MODE_POOLED
+} alloc_mode_t;
+
+/**
+ * \struct AllocHeader_t
+ * \brief  Prefix of every block handed to CyaSSL, 16 bytes so the blocks
+ *          keep the alignment of malloc
+ */
+typedef struct
+{
+    uint32_t    size;
+    uint16_t    origin;
+    uint16_t    size_class;
+    uint32_t    capacity;
+    uint32_t    offset;
+} AllocHeader_t;
+
+/**
+ * \struct AllocFree_t
+ * \brief  Free pool blocks are chained through their payload
+ */
+typedef struct alloc_free
+{
+    struct alloc_free*  next;
+} AllocFree_t;
+
+/**
+ * \struct ArenaChunk_t
+ * \brief  Bump allocated piece of an arena, the blocks follow the chunk header
+ *          and keep their offset to it so a free finds the owning arena
+ */
+typedef struct arena_chunk
+{
+    struct arena_chunk* next;
+    size_t              size;
+    size_t              used;
+    struct tls_arena*   arena;
+} ArenaChunk_t;
+
+/**
+ * \struct TlsArena_t
+ * \brief  Memory of a single connection, freeing a block from it does
+ *          nothing but count it, the whole arena is released in one step
+ *          when the connection is closed, live has to be 0 by then
+ */
+typedef struct tls_arena
+{
+    ArenaChunk_t*   chunks;
+    size_t          total;
+    size_t          live;
+} TlsArena_t;
+
+/**
+ * \struct AllocStats_t
+ * \brief  Per-thread counters of the hooks, system counts the blocks that
+ *          really reached malloc
+ */
+typedef struct
+{
+    unsigned long long  allocations;
+    unsigned long long  frees;
+    unsigned long long  pooled;
+    unsigned long long  arena;
+    unsigned long long  system;
+} AllocStats_t;
+
+static alloc_mode_t             tls_alloc_mode                              = ALLOC_MODE_SYSTEM;
+static int                      tls_alloc_installed                         = 0;
+static __thread AllocStats_t    tls_alloc_stats;
+static __thread AllocFree_t*    tls_alloc_free_lists[ TLS_ALLOC_CLASSES ];
+static __thread ArenaChunk_t*   tls_alloc_spare_chunks;
+static __thread int             tls_alloc_spare_count;
+static __thread TlsArena_t*     tls_alloc_current_arena;
+
+inline static int tls_alloc_size_class( size_t size )
+{
+    int shift = TLS_ALLOC_MIN_SHIFT;
+
+    while( ( ( size_t ) 1 << shift ) < size ) { ++shift; }
+
+    return shift - TLS_ALLOC_MIN_SHIFT;
+}
+
+inline static void* tls_alloc_from_system( size_t size )
+{
+    AllocHeader_t* header = malloc( sizeof( AllocHeader_t ) + size );
+    if( header == 0 ) { return 0; }
+
+    ++tls_alloc_stats.system;
+
+    header->origin      = ALLOC_ORIGIN_SYSTEM;
+    header->capacity    = ( uint32_t ) size;
+
+    return header;
+}
+
+inline static void* tls_alloc_from_pool( size_t size )
+{
+    int size_class          = tls_alloc_size_class( size );
+    AllocHeader_t* header   = ( AllocHeader_t* ) tls_alloc_free_lists[ size_class ];
+
+    if( header != 0 )
+    {
+        tls_alloc_free_lists[ size_class ] = ( ( AllocFree_t* ) header )->next;
+    }
+    else
+    {
+        header = malloc( sizeof( AllocHeader_t ) + ( ( size_t ) 1 << ( size_class + TLS_ALLOC_MIN_SHIFT ) ) );
+        if( header == 0 ) { return 0; }
+
+        ++tls_alloc_stats.system;
+    }
+
+    ++tls_alloc_stats.pooled;
+
+    header->origin      = ALLOC_ORIGIN_POOL;
+    header->size_class  = ( uint16_t ) size_class;
+    header->capacity    = ( uint32_t ) 1 << ( size_class + TLS_ALLOC_MIN_SHIFT );
+
+    return header;
+}
+
+inline static void* tls_alloc_from_arena( TlsArena_t* arena, size_t size )
+{
+    // blocks stay 16 byte aligned
+    size_t needed       = ( sizeof( AllocHeader_t ) + size + 15 ) & ~( size_t ) 15;
+    ArenaChunk_t* chunk = arena->chunks;
+
+    if( chunk == 0 || chunk->used + needed > chunk->size )
+    {
+        size_t chunk_size = sizeof( ArenaChunk_t ) + needed > TLS_ARENA_CHUNK_SIZE ? sizeof( ArenaChunk_t ) + needed : TLS_ARENA_CHUNK_SIZE;
+
+        if( arena->total + chunk_size > TLS_ARENA_MAX ) { return 0; }
+
+        if( chunk_size == TLS_ARENA_CHUNK_SIZE && tls_alloc_spare_chunks != 0 )
+        {
+            chunk                   = tls_alloc_spare_chunks;
+            tls_alloc_spare_chunks  = chunk->next;
+            --tls_alloc_spare_count;
+        }
+        else
+        {
+            chunk = malloc( chunk_size );
+            if( chunk == 0 ) { return 0; }
+
+            ++tls_alloc_stats.system;
+        }
+
+        chunk->size     = chunk_size;
+        chunk->used     = sizeof( ArenaChunk_t );
+        chunk->arena    = arena;
+        chunk->next     = arena->chunks;
+        arena->chunks   = chunk;
+        arena->total    += chunk_size;
+    }
+
+    AllocHeader_t* header = ( AllocHeader_t* ) ( ( char* ) chunk + chunk->used );
+    header->offset  = ( uint32_t ) chunk->used;
+    chunk->used     += needed;
+
+    ++tls_alloc_stats.arena;
+    ++arena->live;
+
+    header->origin      = ALLOC_ORIGIN_ARENA;
+    header->capacity    = ( uint32_t ) ( needed - sizeof( AllocHeader_t ) );
+
+    return header;
+}
+
+static void* tls_alloc_malloc( size_t size )
+{
+    AllocHeader_t* header = 0;
+
+    ++tls_alloc_stats.allocations;
+
+    if( tls_alloc_mode == ALLOC_MODE_POOLED && size <= UINT32_MAX )
+    {
+        if( tls_alloc_current_arena != 0 )
+        {
+            header = tls_alloc_from_arena( tls_alloc_current_arena, size );
+        }
+
+        if( header == 0 && size <= ( ( size_t ) 1 << TLS_ALLOC_MAX_SHIFT ) )
+        {
+            header = tls_alloc_from_pool( size );
+        }
+    }
+
+    if( header == 0 )
+    {
+        header = tls_alloc_from_system( size );
+        if( header == 0 ) { return 0; }
+    }
+
+    header->size = ( uint32_t ) size;
+
+    return header + 1;
+}
+
+static void tls_alloc_free( void* ptr )
+{
+    if( ptr == 0 ) { return; }
+
+    AllocHeader_t* header = ( ( AllocHeader_t* ) ptr ) - 1;
+
+    ++tls_alloc_stats.frees;
+
+    switch( ( alloc_origin_t ) header->origin )
+    {
+        case ALLOC_ORIGIN_SYSTEM:
+            free( header );
+            break;
+        case ALLOC_ORIGIN_POOL:
+        {
+            // goes to the list of the freeing thread, it is private to it,
+            // the link overwrites the header so the class is read first
+            int size_class                      = header->size_class;
+            AllocFree_t* block                  = ( AllocFree_t* ) header;
+            block->next                         = tls_alloc_free_lists[ size_class ];
+            tls_alloc_free_lists[ size_class ]  = block;
+            break;
+        }
+        case ALLOC_ORIGIN_ARENA:
+        {
+            // reclaimed together with the whole arena, only counted here
+            ArenaChunk_t* chunk = ( ArenaChunk_t* ) ( ( char* ) header - header->offset );
+            if( chunk->arena != 0 ) { --chunk->arena->live; }
+            break;
+        }
+    }
+}
+
+static void* tls_alloc_realloc( void* ptr, size_t size )
+{
+    if( ptr == 0 ) { return tls_alloc_malloc( size ); }
+
+    AllocHeader_t* header = ( ( AllocHeader_t* ) ptr ) - 1;
+
+    if( size <= header->capacity )
+    {
+        header->size = ( uint32_t ) size;
+        return ptr;
+    }
+
+    void* resized = tls_alloc_malloc( size );
+    if( resized == 0 ) { return 0; }
+
+    memcpy( resized, ptr, header->size );
+    tls_alloc_free( ptr );
+
+    return resized;
+}
+
+/**
+ * \brief   Installs the hooks into CyaSSL, it has to happen before CyaSSL
+ *          allocates anything and the hooks stay for the rest of the process,
+ *          installing them again switches the mode, every block carries its
+ *          origin so the earlier ones are still freed the right way, no other
+ *          thread may use CyaSSL meanwhile
+ * \return  1 if successfull <0 other way
+ */
+inline static int tls_alloc_install( alloc_mode_t mode )
+{
+    tls_alloc_mode = mode;
+
+    if( tls_alloc_installed ) { return 1; }
+
+    if( CyaSSL_SetAllocators( tls_alloc_malloc, tls_alloc_free, tls_alloc_realloc ) != 0 ) { return -1; }
+
+    tls_alloc_installed = 1;
+
+    return 1;
+}
+
+/**
+ * \brief   Allocations of the calling thread go to arena until the matching
+ *          tls_arena_leave, a zero arena leaves them to the pools, only calls
+ *          whose allocations belong to the SSL object may run in between
+ *          (CyaSSL_new, CyaSSL_set_session, CyaSSL_connect), anything CyaSSL
+ *          keeps beyond CyaSSL_free, e.g. in the context or its session cache,
+ *          would outlive the arena
+ */
+inline static void tls_arena_enter( TlsArena_t* arena )
+{
+    tls_alloc_current_arena = tls_alloc_mode == ALLOC_MODE_POOLED ? arena : 0;
+}
+
+inline static void tls_arena_leave( void )
+{
+    tls_alloc_current_arena = 0;
+}
+
+/**
+ * \brief   Releases every block of the arena in one step, the standard
+ *          chunks are kept by the thread for the next connections, has to
+ *          follow CyaSSL_free so every block is handed back already
+ */
+inline static void tls_arena_release( TlsArena_t* arena )
+{
+    assert( arena != 0 && "Arena must not be null!" );
+    assert( tls_alloc_current_arena != arena && "Arena must not be in use!" );
+    assert( arena->live == 0 && "CyaSSL still holds memory of the arena!" );
+
+    while( arena->chunks != 0 )
+    {
+        ArenaChunk_t* chunk = arena->chunks;
+        arena->chunks       = chunk->next;
+
+        // without asserts a block still held elsewhere keeps its chunk valid
+        if( arena->live != 0 )
+        {
+            chunk->arena = 0;
+            continue;
+        }
+
+        if( chunk->size == TLS_ARENA_CHUNK_SIZE && tls_alloc_spare_count < TLS_ARENA_SPARE_CHUNKS )
+        {
+            chunk->next             = tls_alloc_spare_chunks;
+            tls_alloc_spare_chunks  = chunk;
+            ++tls_alloc_spare_count;
+        }
+        else
+        {
+            free( chunk );
+        }
+    }
+
+    arena->total    = 0;
+    arena->live     = 0;
+}
+
+/**
+ * \brief   Gives the pooled and spare memory of the calling thread back to
+ *          the system, nothing of this thread may be in use anymore
+ */
+inline static void tls_alloc_thread_release( void )
+{
+    for( int i = 0; i < TLS_ALLOC_CLASSES; ++i )
+    {
+        while( tls_alloc_free_lists[ i ] != 0 )
+        {
+            AllocFree_t* next = tls_alloc_free_lists[ i ]->next;
+            free( tls_alloc_free_lists[ i ] );
+            tls_alloc_free_lists[ i ] = next;
+        }
+    }
+
+    while( tls_alloc_spare_chunks != 0 )
+    {
+        ArenaChunk_t* next = tls_alloc_spare_chunks->next;
+        free( tls_alloc_spare_chunks );
+        tls_alloc_spare_chunks = next;
+    }
+
+    tls_alloc_spare_count = 0;
+}
+
+/**
+ * \return  counters of the calling thread
+ */
+inline static AllocStats_t tls_alloc_thread_stats( void )
+{
+    return tls_alloc_stats;
+}
+
+inline static void tls_alloc_stats_merge( AllocStats_t* dst, const AllocStats_t* src )
+{
+    dst->allocations    += src->allocations;
+    dst->frees          += src->frees;
+    dst->pooled         += src->pooled;
+    dst->arena          += src->arena;
+    dst->system         += src->system;
+}
+
+#endif // __TLS_ALLOC_H__
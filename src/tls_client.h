@@ -0,0 +1,1439 @@
+#ifndef __TLS_CLIENT_H__
+#define __TLS_CLIENT_H__
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <cyassl/ssl.h>
+
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/eventfd.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "buffer_pool.h"
+#include "client_context.h"
+#include "crypto_pool.h"
+#include "debug.h"
+#include "event_loop.h"
+#include "histogram.h"
+#include "http_parser.h"
+#include "payload.h"
+#include "phase_timing.h"
+#include "send_queue.h"
+#include "session_cache.h"
+#include "timer_wheel.h"
+#include "tls_io.h"
+#include "trust_store.h"
+#include "uring_loop.h"
+
+// borrowed from libxively
+#include "xi_coroutine.h"
+
+// bytes a connection may queue ahead of CyaSSL before producers are held back
+#define CLIENT_SEND_HIGH_WATER  ( 64 * 1024 )
+
+/**
+ * \brief Deadlines a connection can miss, connect and handshake bound their
+ *          phase, response bounds the wait for the first byte of a response
+ *          and idle any other wait for the socket
+ */
+typedef enum deadline
+{
+    DEADLINE_CONNECT    = 0,
+    DEADLINE_HANDSHAKE,
+    DEADLINE_IDLE,
+    DEADLINE_RESPONSE,
+    DEADLINE_COUNT
+} deadline_t;
+
+static const char* const deadline_names[ DEADLINE_COUNT ] =
+{
+      "connect"
+    , "handshake"
+    , "idle"
+    , "response"
+};
+
+/**
+ * \struct ConnTimeouts_t
+ * \brief  Milliseconds allowed for every deadline, 0 disables it
+ */
+typedef struct
+{
+    int     ms[ DEADLINE_COUNT ];
+} ConnTimeouts_t;
+
+/**
+ * \struct ConnStats_t
+ * \brief  Counters and latency histograms, one instance per worker so the
+ *          connections of a shard can update it without any locking
+ */
+typedef struct
+{
+    unsigned long       handshakes;
+    unsigned long       requests;
+    unsigned long       timeouts;
+    unsigned long long  io_waits;
+    unsigned long long  io_completions;
+    unsigned long long  crypto_jobs;
+    unsigned long long  bytes_sent;
+    unsigned long long  bytes_received;
+    SendStats_t         sends;
+    PhaseHistograms_t   phases;
+    Histogram_t         request_latency;
+    AllocStats_t        allocator;
+    const char*         cipher;
+} ConnStats_t;
+
+inline static void conn_stats_init( ConnStats_t* stats )
+{
+    assert( stats != 0 && "Stats must not be null!" );
+
+    memset( stats, 0, sizeof( ConnStats_t ) );
+    phase_histograms_init( &stats->phases );
+    histogram_init( &stats->request_latency );
+}
+
+inline static void conn_stats_merge( ConnStats_t* dst, const ConnStats_t* src )
+{
+    assert( dst != 0 && src != 0 && "Stats must not be null!" );
+
+    dst->handshakes     += src->handshakes;
+    dst->requests       += src->requests;
+    dst->timeouts       += src->timeouts;
+    dst->io_waits       += src->io_waits;
+    dst->io_completions += src->io_completions;
+    dst->crypto_jobs    += src->crypto_jobs;
+    dst->bytes_sent     += src->bytes_sent;
+    dst->bytes_received += src->bytes_received;
+    dst->sends.calls    += src->sends.calls;
+    dst->sends.syscalls += src->sends.syscalls;
+
+    phase_histograms_merge( &dst->phases, &src->phases );
+    histogram_merge( &dst->request_latency, &src->request_latency );
+    tls_alloc_stats_merge( &dst->allocator, &src->allocator );
+
+    if( dst->cipher == 0 ) { dst->cipher = src->cipher; }
+}
+
+inline static void conn_stats_print_latency( const ConnStats_t* stats )
+{
+    assert( stats != 0 && "Stats must not be null!" );
+
+    phase_histograms_print( &stats->phases );
+    histogram_print( &stats->request_latency, "request", "us" );
+}
+
+/**
+ * \struct ConnCtx_t
+ * \brief  Per-connection coroutine context, holds the resume point and
+ *          every local of main_handle that has to survive a yield
+ */
+typedef struct
+{
+    short               cs;
+    int                 state;
+    SendQueue_t         send_queue;
+    char*               recv_buffer;
+    HttpParser_t        response;
+    CYASSL*             cya_obj;
+    Conn_t              conn;
+    EventHandle_t       event_handle;
+#ifdef USE_IO_URING
+    UringLoop_t*        uring;
+    UringTransport_t    transport;
+    uint32_t            slot;
+#endif
+    Timer_t             deadline;
+    deadline_t          deadline_kind;
+    int                 deadline_missed;
+    CryptoPool_t*       crypto_pool;
+    CryptoJob_t         crypto_job;
+    int                 crypto_pending;
+    TimerWheel_t*       timer_wheel;
+    const ConnTimeouts_t* timeouts;
+    const SocketProfile_t* socket_profile;
+    struct timespec     phase_start;
+    struct timespec     handshake_start;
+    struct timespec     request_start;
+    ConnStats_t*        stats;
+    SessionCache_t*     session_cache;
+    BufferPool_t*       buffer_pool;
+    const BodySource_t* body;
+    char*               body_chunk;
+    size_t              body_offset;
+    int                 reconnects_left;
+    int                 requests_per_connection;
+    int                 requests_left;
+    int                 pipeline_depth;
+    int                 pipeline_batch;
+    int                 pipeline_queued;
+    int                 pipeline_answered;
+    size_t              recv_offset;
+    size_t              recv_size;
+} ConnCtx_t;
+
+/**
+ * \brief   Initializes the cyassl library and creates the context, the
+ *          context is shared by every worker so it is fully set up here,
+ *          the same way the library sets up its contexts
+ * \return  context if successfull 0 other way
+ */
+inline static CYASSL_CTX* init_cyaSSL( alloc_mode_t alloc_mode, const char* cipher_list, const char* verify, uint64_t* trust_load_us )
+{
+    // the hooks must see every allocation CyaSSL ever makes
+    if( tls_alloc_install( alloc_mode ) < 0 ) { return 0; }
+
+    CyaSSL_Init();
+
+    return client_context_new( cipher_list, verify, trust_load_us );
+}
+
+/**
+ * \brief   Replaces the pending deadline of the connection, it is measured
+ *          from the time the wheel was last advanced to
+ */
+inline static void conn_ctx_arm( ConnCtx_t* ctx, deadline_t deadline )
+{
+    const int timeout_ms = ctx->timeouts->ms[ deadline ];
+
+    ctx->deadline_kind = deadline;
+
+    if( timeout_ms > 0 )
+    {
+        timer_wheel_schedule( ctx->timer_wheel, &ctx->deadline, ( uint64_t ) timeout_ms );
+    }
+    else
+    {
+        timer_wheel_cancel( ctx->timer_wheel, &ctx->deadline );
+    }
+}
+
+inline static ConnCtx_t* conn_ctx_of_deadline( Timer_t* timer )
+{
+    return ( ConnCtx_t* ) ( ( char* ) timer - offsetof( ConnCtx_t, deadline ) );
+}
+
+static int main_handle(
+                          ConnCtx_t*    ctx
+                        , const char*   data
+                        , const size_t  data_size )
+{
+    assert( ctx != 0 && "ctx must not be null!" );
+    assert( ctx->cya_obj != 0 && "cya_obj must not be null!" );
+    assert( ctx->stats != 0 && "stats must not be null!" );
+
+    // everything that must exist through yields lives in ctx
+    CYASSL* cya_obj                     = ctx->cya_obj;
+    Conn_t* conn                        = &ctx->conn;
+    int connected                       = 0;
+
+    BEGIN_CORO_CTX( ctx )
+
+    // restarted
+    ctx->state = SSL_SUCCESS;
+
+    phase_begin( &ctx->phase_start );
+    conn_ctx_arm( ctx, DEADLINE_CONNECT );
+
+    // first part of the coroutine is about connecting to the endpoint, with
+    // fast open there is no connect, the send callback puts the ClientHello
+    // into the SYN
+    connected = conn_connect_start( conn, ctx->socket_profile->fast_open );
+
+    if( connected < 0 )
+    {
+        debug_fmt( "Connection failed %s", strerror( errno ) );
+        return -1;
+    }
+
+    if( connected == 0 )
+    {
+        debug_log( "Connecting..." );
+
+        YIELD_CTX( ctx, ( int ) WANT_WRITE );
+
+        if( conn_connect_finish( conn ) < 0 )
+        {
+            debug_fmt( "Error while connecting %s", strerror( errno ) );
+            return -1;
+        }
+    }
+
+    debug_fmt( "Connected! state = %d", ctx->state );
+
+    phase_transition( &ctx->stats->phases, &ctx->phase_start, PHASE_CONNECT );
+
+    // part two is actually to do the ssl handshake
+    {
+        conn_ctx_arm( ctx, DEADLINE_HANDSHAKE );
+
+        if( ctx->session_cache != 0 )
+        {
+            CYASSL_SESSION* session = session_cache_lookup( ctx->session_cache, &conn->endpoint_addr );
+
+            // the handshake state, resumed or not, lives in the arena of the connection
+            tls_arena_enter( &conn->arena );
+            int set = session != 0 ? CyaSSL_set_session( cya_obj, session ) : SSL_SUCCESS;
+            tls_arena_leave();
+
+            if( set != SSL_SUCCESS )
+            {
+                debug_log( "Cached session rejected, doing a full handshake" );
+            }
+        }
+
+        clock_gettime( CLOCK_MONOTONIC, &ctx->handshake_start );
+
+        do
+        {
+            if( ctx->state == SSL_ERROR_WANT_READ )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_READ );
+            }
+
+            if( ctx->state == SSL_ERROR_WANT_WRITE )
+            {
+                YIELD_CTX( ctx, ( int ) WANT_WRITE );
+            }
+
+            debug_log( "Connecting SSL..." );
+
+            if( ctx->crypto_pool != 0 )
+            {
+                // any step may find the server flight already in and do the
+                // public key math, so every step runs on the crypto pool
+                YIELD_CTX( ctx, ( int ) WANT_CRYPTO );
+                ctx->state = ctx->crypto_job.state;
+            }
+            else
+            {
+                ctx->state = tls_connect_step( cya_obj, &conn->arena );
+            }
+
+            debug_fmt( "Connecting SSL state [%d][%d]", ctx->state, ( int ) SSL_SUCCESS );
+
+        } while( ctx->state != SSL_SUCCESS && ( ctx->state == SSL_ERROR_WANT_READ || ctx->state == SSL_ERROR_WANT_WRITE ) );
+
+        // we've connected or failed
+        if( ctx->state != SSL_SUCCESS )
+        {
+            // something went wrong
+            EXIT_CTX( ctx, -1 );
+        }
+
+        ++ctx->stats->handshakes;
+
+        // CyaSSL hands out the static name of the suite
+        if( ctx->stats->cipher == 0 ) { ctx->stats->cipher = CyaSSL_get_cipher( cya_obj ); }
+        phase_transition( &ctx->stats->phases, &ctx->phase_start, PHASE_HANDSHAKE );
+
+        if( ctx->session_cache != 0 )
+        {
+            session_cache_record_handshake(
+                      ctx->session_cache
+                    , CyaSSL_session_reused( cya_obj )
+                    , session_cache_elapsed_ms( &ctx->handshake_start ) );
+
+            session_cache_store( ctx->session_cache, &conn->endpoint_addr, CyaSSL_get_session( cya_obj ) );
+        }
+    }
+
+    // parts three and four are repeated while the connection is kept alive
+    for( ; ; )
+    {
+        // part three sending a batch of requests back to back, the requests
+        // and then the body chunks go through the send queue, the requests
+        // are borrowed from the payload
+        {
+            ctx->pipeline_batch     = ctx->pipeline_depth < ctx->requests_left ? ctx->pipeline_depth : ctx->requests_left;
+            ctx->pipeline_queued    = 0;
+
+            clock_gettime( CLOCK_MONOTONIC, &ctx->request_start );
+            conn_ctx_arm( ctx, DEADLINE_IDLE );
+
+            // the body is pulled one record at a time, the next chunk is
+            // produced only after CyaSSL has taken the previous one entirely
+            if( ctx->body != 0 )
+            {
+                ctx->body_chunk     = buffer_pool_borrow( ctx->buffer_pool );
+                ctx->body_offset    = 0;
+
+                if( ctx->body_chunk == 0 )
+                {
+                    error_log( "Could not borrow the body chunk" );
+                    EXIT_CTX( ctx, -1 );
+                }
+            }
+
+            for( ; ; )
+            {
+                // the queue takes the requests of the batch up to its high-water mark
+                while( ctx->pipeline_queued < ctx->pipeline_batch )
+                {
+                    int queued = send_queue_push( &ctx->send_queue, data, data_size, 0 );
+
+                    if( queued < 0 )
+                    {
+                        error_log( "Could not queue the request" );
+                        EXIT_CTX( ctx, -1 );
+                    }
+
+                    if( queued == 0 ) { break; }
+
+                    ++ctx->pipeline_queued;
+                }
+
+                while( !send_queue_empty( &ctx->send_queue ) )
+                {
+                    if( ctx->state == SSL_ERROR_WANT_READ )
+                    {
+                        YIELD_CTX( ctx, ( int ) WANT_READ );
+                    }
+
+                    if( ctx->state == SSL_ERROR_WANT_WRITE )
+                    {
+                        YIELD_CTX( ctx, ( int ) WANT_WRITE );
+                    }
+
+                    int ret = send_queue_write( &ctx->send_queue, cya_obj, &ctx->state );
+                    debug_fmt( "Sending SSL state state = [%d], ret = [%d], queued = [%zu]", ctx->state, ret, ctx->send_queue.bytes );
+
+                    if( ret > 0 )
+                    {
+                        ctx->stats->bytes_sent  += ret;
+                        conn_ctx_arm( ctx, DEADLINE_IDLE );
+                    }
+                    else if( ctx->state != SSL_ERROR_WANT_READ && ctx->state != SSL_ERROR_WANT_WRITE )
+                    {
+                        debug_log( "Exiting" );
+                        EXIT_CTX( ctx, -1 );
+                    }
+                }
+
+                if( ctx->pipeline_queued < ctx->pipeline_batch ) { continue; }
+
+                if( ctx->body == 0 ) { break; }
+
+                {
+                    ssize_t produced = ctx->body->produce( ctx->body->user, ctx->body_chunk, BUFFER_POOL_SLAB_SIZE, ctx->body_offset );
+
+                    if( produced < 0 )
+                    {
+                        error_fmt( "Body producer failed at offset %zu", ctx->body_offset );
+                        EXIT_CTX( ctx, -1 );
+                    }
+
+                    if( produced == 0 ) { break; }
+
+                    // the chunk stays put until the queue has written it entirely
+                    if( send_queue_push( &ctx->send_queue, ctx->body_chunk, ( size_t ) produced, 0 ) < 0 )
+                    {
+                        error_log( "Could not queue the body chunk" );
+                        EXIT_CTX( ctx, -1 );
+                    }
+
+                    ctx->body_offset += ( size_t ) produced;
+                }
+            }
+
+            if( ctx->body != 0 )
+            {
+                debug_fmt( "Body streamed, %zu bytes", ctx->body_offset );
+
+                buffer_pool_return( ctx->buffer_pool, ctx->body_chunk );
+                ctx->body_chunk = 0;
+            }
+
+            phase_transition( &ctx->stats->phases, &ctx->phase_start, PHASE_SEND );
+        }
+
+        // part four receive, the responses of the batch come back in order,
+        // the parser stops at the end of each one and whatever was read past
+        // it is fed to the parser of the next one, the slab is only held
+        // while responses are in flight
+        {
+            ctx->recv_buffer = buffer_pool_borrow( ctx->buffer_pool );
+
+            if( ctx->recv_buffer == 0 )
+            {
+                error_log( "Could not borrow the receive buffer" );
+                EXIT_CTX( ctx, -1 );
+            }
+
+            ctx->recv_offset        = 0;
+            ctx->recv_size          = 0;
+            ctx->pipeline_answered  = 0;
+
+            while( ctx->pipeline_answered < ctx->pipeline_batch )
+            {
+                http_parser_init( &ctx->response );
+                conn_ctx_arm( ctx, DEADLINE_RESPONSE );
+
+                do
+                {
+                    if( ctx->recv_offset < ctx->recv_size )
+                    {
+                        long consumed = http_parser_feed( &ctx->response, ctx->recv_buffer + ctx->recv_offset, ctx->recv_size - ctx->recv_offset );
+
+                        if( consumed < 0 )
+                        {
+                            error_log( "Malformed response" );
+                            EXIT_CTX( ctx, -1 );
+                        }
+
+                        ctx->recv_offset += ( size_t ) consumed;
+                        continue;
+                    }
+
+                    if( ctx->state == SSL_ERROR_WANT_READ )
+                    {
+                        YIELD_CTX( ctx, ( int ) WANT_READ );
+                    }
+
+                    if( ctx->state == SSL_ERROR_WANT_WRITE )
+                    {
+                        YIELD_CTX( ctx, ( int ) WANT_WRITE );
+                    }
+
+                    int ret     = CyaSSL_read( cya_obj, ctx->recv_buffer, BUFFER_POOL_SLAB_SIZE );
+                    ctx->state  = ret <= 0 ? CyaSSL_get_error( cya_obj, ret ) : SSL_SUCCESS;
+
+                    if( ret > 0 )
+                    {
+                        debug_fmt( "Received SSL... size = [%d], state = [%d]", ret, ctx->state );
+                        ctx->stats->bytes_received += ret;
+                        conn_ctx_arm( ctx, DEADLINE_IDLE );
+
+                        ctx->recv_offset    = 0;
+                        ctx->recv_size      = ( size_t ) ret;
+                    }
+                    else if( ctx->state != SSL_ERROR_WANT_READ && ctx->state != SSL_ERROR_WANT_WRITE )
+                    {
+                        // a closed connection only ends a response that is delimited by the close
+                        if( http_parser_finish( &ctx->response ) < 0 )
+                        {
+                            debug_fmt( "Connection lost in the middle of the response, state = [%d]", ctx->state );
+                            EXIT_CTX( ctx, -1 );
+                        }
+
+                        ctx->state = SSL_SUCCESS;
+                    }
+                } while( !http_parser_done( &ctx->response ) );
+
+                debug_fmt( "Response complete, status = [%d], body = [%llu]", ctx->response.status_code, ctx->response.body_size );
+
+                // every response of the batch waited since the batch was written
+                ++ctx->pipeline_answered;
+                ++ctx->stats->requests;
+                histogram_record( &ctx->stats->request_latency, elapsed_us( &ctx->request_start ) );
+
+                if( ctx->response.connection_close ) { break; }
+            }
+
+            if( ctx->recv_offset < ctx->recv_size )
+            {
+                debug_fmt( "Dropping %zu bytes received past the end of the batch", ctx->recv_size - ctx->recv_offset );
+            }
+
+            buffer_pool_return( ctx->buffer_pool, ctx->recv_buffer );
+            ctx->recv_buffer = 0;
+        }
+
+        phase_transition( &ctx->stats->phases, &ctx->phase_start, PHASE_RECEIVE );
+
+        ctx->requests_left -= ctx->pipeline_batch;
+
+        if( ctx->requests_left <= 0 ) { break; }
+
+        if( ctx->response.connection_close )
+        {
+            if( ctx->pipeline_answered < ctx->pipeline_batch )
+            {
+                debug_fmt( "Server closes the connection, %d pipelined requests stay unanswered", ctx->pipeline_batch - ctx->pipeline_answered );
+            }
+
+            debug_log( "Server closes the connection, no more keep-alive requests" );
+            break;
+        }
+
+        debug_fmt( "Keep-alive, %d more requests on this connection", ctx->requests_left );
+    }
+
+    RESTART_CTX( ctx, 0 );
+
+    END_CORO()
+}
+
+/**
+ * \brief   Creates the socket and the CyaSSL object of a single connection,
+ *          the endpoint, session cache, reconnect and keep-alive budgets
+ *          of ctx are kept
+ * \return  1 if successfull <0 other way
+ */
+inline static int conn_ctx_open( ConnCtx_t* ctx, CYASSL_CTX* cya_ctx )
+{
+    assert( ctx != 0 && cya_ctx != 0 && "ctx and cya_ctx must not be null!" );
+
+    CORO_CTX_INIT( ctx );
+    ctx->state          = 0;
+    ctx->requests_left  = ctx->requests_per_connection;
+
+    ctx->deadline_missed    = 0;
+    ctx->crypto_pending     = 0;
+
+    ctx->conn.sock_fd   = create_non_blocking_socket();
+    ctx->conn.fast_open = 0;
+    if( ctx->conn.sock_fd < 0 ) { return -1; }
+
+    if( apply_socket_profile( ctx->conn.sock_fd, ctx->socket_profile ) < 0 )
+    {
+        error_fmt( "socket profile could not be applied: %s", strerror( errno ) );
+        close( ctx->conn.sock_fd );
+        return -1;
+    }
+
+    memset( &ctx->event_handle, 0, sizeof( ctx->event_handle ) );
+    ctx->event_handle.fd = ctx->conn.sock_fd;
+
+    ctx->cya_obj = create_cyassl_object( cya_ctx, &ctx->conn );
+    if( ctx->cya_obj == 0 )
+    {
+        close( ctx->conn.sock_fd );
+        return -1;
+    }
+
+    set_cyassl_flags( ctx->cya_obj );
+
+#ifdef USE_IO_URING
+    // CyaSSL talks to the staged buffers of the transport instead of the fd
+    if( ctx->uring != 0 )
+    {
+        uring_transport_open( &ctx->transport, ctx->uring, ctx->slot, ctx->conn.sock_fd, ctx );
+        CyaSSL_SetIOReadCtx( ctx->cya_obj, &ctx->transport );
+        CyaSSL_SetIOWriteCtx( ctx->cya_obj, &ctx->transport );
+    }
+#endif
+
+    return 1;
+}
+
+/**
+ * \brief   Closes the connection wherever its coroutine is, it can be
+ *          reopened with conn_ctx_open
+ */
+inline static void conn_ctx_close( EventLoop_t* loop, ConnCtx_t* ctx )
+{
+    event_loop_unwatch( loop, &ctx->event_handle );
+    timer_wheel_cancel( ctx->timer_wheel, &ctx->deadline );
+
+#ifdef USE_IO_URING
+    if( ctx->uring != 0 ) { uring_transport_close( &ctx->transport ); }
+#endif
+
+    ctx->cya_obj = closeSSL( ctx->cya_obj, &ctx->conn );
+
+    // a connection that failed half way still holds its messages and slabs
+    send_queue_clear( &ctx->send_queue );
+    buffer_pool_return( ctx->buffer_pool, ctx->body_chunk );
+    buffer_pool_return( ctx->buffer_pool, ctx->recv_buffer );
+    ctx->body_chunk     = 0;
+    ctx->recv_buffer    = 0;
+}
+
+/**
+ * \brief   Resumes the coroutine of ctx and registers the event it waits for,
+ *          finished connections are reopened while reconnects are left
+ * \return  1 if the connection is still active, 0 when it is done, <0 on failure
+ */
+inline static int conn_ctx_resume(
+                          EventLoop_t*  loop
+                        , ConnCtx_t*    ctx
+                        , CYASSL_CTX*   cya_ctx
+                        , const char*   data
+                        , const size_t  data_size )
+{
+    for( ; ; )
+    {
+        debug_log( "main_handle..." );
+        int ret = main_handle( ctx, data, data_size );
+        debug_log( "main_handle done!" );
+
+        if( ret == WANT_CRYPTO )
+        {
+            // the fd must not resume the coroutine while another thread runs
+            // the connection, the worker resumes it once the job is back
+            event_loop_unwatch( loop, &ctx->event_handle );
+            ctx->crypto_pending = 1;
+            ++ctx->stats->crypto_jobs;
+            crypto_pool_submit( ctx->crypto_pool, &ctx->crypto_job, ctx->cya_obj, &ctx->conn.arena );
+            return 1;
+        }
+
+        if( ret > 0 )
+        {
+#ifdef USE_IO_URING
+            if( ctx->uring != 0 )
+            {
+                uring_transport_watch( &ctx->transport, ( wanted_event_t ) ret );
+                return 1;
+            }
+#endif
+            // staged records have to reach the peer before anything comes
+            // back, what the socket does not take yet is waited for first
+            int flushed = conn_output_flush( &ctx->conn );
+            if( flushed == 0 ) { ret = WANT_WRITE; }
+
+            if( flushed >= 0 && event_loop_watch( loop, &ctx->event_handle, ( wanted_event_t ) ret, ctx ) > 0 ) { return 1; }
+            ret = -1;
+        }
+
+        conn_ctx_close( loop, ctx );
+
+        if( ret < 0 )                       { return -1; }
+        if( ctx->reconnects_left-- <= 0 )   { return 0; }
+        if( conn_ctx_open( ctx, cya_ctx ) < 0 ) { return -1; }
+    }
+}
+
+/**
+ * \struct Worker_t
+ * \brief  One reactor thread, it owns its event loop and its shard of the
+ *          connections, only the CyaSSL context and the session cache are
+ *          shared between workers
+ */
+typedef struct
+{
+    pthread_t       thread;
+    int             id;
+    int             cpu;
+    EventLoop_t     event_loop;
+#ifdef USE_IO_URING
+    UringLoop_t     uring;
+#endif
+    int             io_uring;
+    TimerWheel_t    timer_wheel;
+    BufferPool_t    buffer_pool;
+    CryptoDone_t    crypto_done;
+    EventHandle_t   crypto_handle;
+    ConnCtx_t*      conn_ctxs;
+    int             connections;
+    CYASSL_CTX*     cya_ctx;
+    const char*     data;
+    size_t          data_size;
+    int             failed;
+    int             dump_fd;
+    EventHandle_t   dump_handle;
+    ConnStats_t     stats;
+} Worker_t;
+
+// the eventfds of all workers, SIGUSR1 writes to every one of them so even
+// a worker that waits without a timeout wakes up and dumps its histograms
+static int* stats_dump_fds          = 0;
+static int  stats_dump_fd_count     = 0;
+
+static void on_stats_dump_signal( int sig )
+{
+    ( void ) sig;
+
+    const int saved_errno   = errno;
+    const uint64_t one      = 1;
+
+    for( int i = 0; i < stats_dump_fd_count; ++i )
+    {
+        if( write( stats_dump_fds[ i ], &one, sizeof( one ) ) < 0 ) { }
+    }
+
+    errno = saved_errno;
+}
+
+/**
+ * \brief   Dumps the histograms of a worker from its own thread so the
+ *          snapshot is consistent
+ */
+inline static void worker_dump_stats( const Worker_t* worker )
+{
+    flockfile( stdout );
+
+    printf( "worker %d: handshakes %lu, requests %lu\n", worker->id, worker->stats.handshakes, worker->stats.requests );
+    conn_stats_print_latency( &worker->stats );
+    fflush( stdout );
+
+    funlockfile( stdout );
+}
+
+/**
+ * \brief   Called once the dump eventfd of the worker is readable, several
+ *          signals in a row give a single dump
+ */
+inline static void worker_dump_requested( Worker_t* worker )
+{
+    uint64_t count = 0;
+
+    while( read( worker->dump_fd, &count, sizeof( count ) ) < 0 && errno == EINTR ) { }
+
+    if( count > 0 ) { worker_dump_stats( worker ); }
+}
+
+/**
+ * \brief   Resumes a connection of the worker and counts it once it ends
+ * \return  1 if the connection is still active 0 other way
+ */
+inline static int worker_resume( Worker_t* worker, ConnCtx_t* ctx )
+{
+    int ret = conn_ctx_resume( &worker->event_loop, ctx, worker->cya_ctx, worker->data, worker->data_size );
+
+    if( ret < 0 )
+    {
+        error_fmt( "worker %d connection %d failed", worker->id, ( int ) ( ctx - worker->conn_ctxs ) );
+        ++worker->failed;
+    }
+
+    return ret > 0;
+}
+
+/**
+ * \brief   Closes a connection that missed its deadline, one whose crypto
+ *          step is still running is closed once the step is back
+ * \return  1 if the connection ended 0 other way
+ */
+inline static int worker_expire( Worker_t* worker, ConnCtx_t* ctx )
+{
+    if( ctx->crypto_pending )
+    {
+        ctx->deadline_missed = 1;
+        return 0;
+    }
+
+    error_fmt( "worker %d connection %d missed its %s deadline"
+        , worker->id, ( int ) ( ctx - worker->conn_ctxs ), deadline_names[ ctx->deadline_kind ] );
+
+    conn_ctx_close( &worker->event_loop, ctx );
+
+    ++worker->stats.timeouts;
+    ++worker->failed;
+
+    return 1;
+}
+
+/**
+ * \brief   Resumes the connections whose crypto step is done
+ * \return  number of connections that ended
+ */
+inline static int worker_crypto_done( Worker_t* worker )
+{
+    int ended       = 0;
+    CryptoJob_t* job = crypto_done_take( &worker->crypto_done );
+
+    while( job != 0 )
+    {
+        CryptoJob_t* next   = job->next;
+        ConnCtx_t* ctx      = ( ConnCtx_t* ) ( ( char* ) job - offsetof( ConnCtx_t, crypto_job ) );
+
+        ctx->crypto_pending = 0;
+
+        if( ctx->deadline_missed )          { ended += worker_expire( worker, ctx ); }
+        else if( !worker_resume( worker, ctx ) ) { ++ended; }
+
+        job = next;
+    }
+
+    return ended;
+}
+
+/**
+ * \brief   Waits on whichever backend the worker runs on
+ * \return  >0 if something is ready, 0 on timeout, <0 on error with errno set
+ */
+inline static int worker_wait( Worker_t* worker, int timeout_ms )
+{
+#ifdef USE_IO_URING
+    if( worker->io_uring )
+    {
+        int ret = uring_loop_wait( &worker->uring, timeout_ms );
+
+        if( ret == 0 )      { return 1; }
+        if( ret == -ETIME ) { return 0; }
+
+        errno = -ret;
+        return -1;
+    }
+#endif
+
+    return event_loop_wait( &worker->event_loop, timeout_ms );
+}
+
+/**
+ * \brief   Resumes the connections that became ready
+ * \return  number of connections that ended
+ */
+inline static int worker_dispatch( Worker_t* worker, int ready )
+{
+    int ended = 0;
+
+#ifdef USE_IO_URING
+    if( worker->io_uring )
+    {
+        ConnCtx_t* ctx = 0;
+
+        // every completion already moved its bytes into the transport
+        while( ( ctx = ( ConnCtx_t* ) uring_loop_next( &worker->uring ) ) != 0 )
+        {
+            if( !worker_resume( worker, ctx ) ) { ++ended; }
+        }
+
+        if( worker->uring.woken )
+        {
+            worker->uring.woken = 0;
+            worker_dump_requested( worker );
+            uring_loop_watch_wake( &worker->uring, worker->dump_fd );
+        }
+
+        return ended;
+    }
+#endif
+
+    // resume only the connections that reported readiness, the crypto
+    // done list and the dump eventfd are the registrations without a connection
+    for( int i = 0; i < ready; ++i )
+    {
+        void* data      = event_loop_data( &worker->event_loop, i );
+        ConnCtx_t* ctx  = ( ConnCtx_t* ) data;
+
+        if( data == &worker->dump_handle )      { worker_dump_requested( worker ); }
+        else if( ctx == 0 )                     { ended += worker_crypto_done( worker ); }
+        else if( !worker_resume( worker, ctx ) ) { ++ended; }
+    }
+
+    return ended;
+}
+
+/**
+ * \brief   Event loop of a single worker, runs until every connection of
+ *          its shard is done or failed
+ */
+static void* worker_run( void* arg )
+{
+    Worker_t* worker    = ( Worker_t* ) arg;
+    int active          = worker->connections;
+
+    const AllocStats_t alloc_start = tls_alloc_thread_stats();
+
+    timer_wheel_init( &worker->timer_wheel, timer_wheel_clock_ms() );
+
+    if( worker->cpu >= 0 ) { pin_thread( worker->id, worker->cpu ); }
+
+    if( worker->crypto_done.event_fd >= 0
+        && event_loop_watch( &worker->event_loop, &worker->crypto_handle, WANT_READ, 0 ) < 0 )
+    {
+        DIE( "Could not watch the crypto done list!", 0 );
+    }
+
+#ifdef USE_IO_URING
+    if( worker->io_uring ) { uring_loop_watch_wake( &worker->uring, worker->dump_fd ); }
+    else
+#endif
+    if( event_loop_watch( &worker->event_loop, &worker->dump_handle, WANT_READ, &worker->dump_handle ) < 0 )
+    {
+        DIE( "Could not watch the stats dump eventfd!", 0 );
+    }
+
+    // kick every coroutine off, each one runs until it needs its socket
+    for( int i = 0; i < worker->connections; ++i )
+    {
+        if( !worker_resume( worker, &worker->conn_ctxs[ i ] ) ) { --active; }
+    }
+
+    while( active > 0 )
+    {
+        debug_fmt( "worker %d wait... active = [%d]", worker->id, active );
+
+        // sleep no longer than until the next deadline may fire, without any
+        // deadline armed only the connections decide when they are done
+        int timeout_ms  = worker->timer_wheel.count > 0 ? timer_wheel_next_timeout_ms( &worker->timer_wheel, EVENT_LOOP_TIMEOUT_MS ) : -1;
+        int e_ret       = worker_wait( worker, timeout_ms );
+
+        debug_fmt( "worker %d wait done [%d]", worker->id, e_ret );
+
+        if( e_ret < 0 && errno == EINTR ) continue;
+        if( e_ret < 0 )     DIE( "error on wait...", 0 );
+
+        // a single clock read per wakeup, the deadlines armed below count from it
+        timer_wheel_advance( &worker->timer_wheel, timer_wheel_clock_ms() );
+
+        active -= worker_dispatch( worker, e_ret );
+
+        // whatever is still expired made no progress in time, resuming the
+        // connections above has already taken the others out of the queue
+        Timer_t* timer = 0;
+
+        while( ( timer = timer_wheel_pop_expired( &worker->timer_wheel ) ) != 0 )
+        {
+            active -= worker_expire( worker, conn_ctx_of_deadline( timer ) );
+        }
+    }
+
+    // only what this worker did, the main thread also set the context up
+    const AllocStats_t alloc_end        = tls_alloc_thread_stats();
+    worker->stats.allocator.allocations = alloc_end.allocations - alloc_start.allocations;
+    worker->stats.allocator.frees       = alloc_end.frees - alloc_start.frees;
+    worker->stats.allocator.pooled      = alloc_end.pooled - alloc_start.pooled;
+    worker->stats.allocator.arena       = alloc_end.arena - alloc_start.arena;
+    worker->stats.allocator.system      = alloc_end.system - alloc_start.system;
+    worker->stats.sends                 = tls_io_send_stats;
+
+    tls_alloc_thread_release();
+
+#ifdef USE_IO_URING
+    worker->stats.io_waits          = worker->uring.waits;
+    worker->stats.io_completions    = worker->uring.completions;
+#endif
+
+    return 0;
+}
+
+/**
+ * \struct ClientOptions_t
+ * \brief  Command line of the client binaries
+ */
+typedef struct
+{
+    int         connections;
+    int         reconnects;
+    int         keep_alive_requests;
+    int         pipeline_depth;
+    int         resumption;
+    int         threads;
+    int         pin;
+    int         pooled_allocator;
+    int         io_uring;
+    int         crypto_threads;
+    ConnTimeouts_t timeouts;
+    SocketProfile_t socket_profile;
+    const char* server_ip;
+    const char* server_port;
+    const char* request_file;
+    const char* request_data;
+    size_t      request_size;
+    const char* body_file;
+    const char* verify;
+    const char* cipher_list;
+    int         cipher_matrix;
+} ClientOptions_t;
+
+/**
+ * \struct ClientResult_t
+ * \brief  Outcome of client_run, stats are merged over all workers
+ */
+typedef struct
+{
+    int             failed;
+    double          elapsed_s;
+    uint64_t        trust_load_us;
+    ConnStats_t     stats;
+    SessionCache_t  session_cache;
+} ClientResult_t;
+
+inline static void client_print_usage( const char* name )
+{
+    printf( "Usage: %s [-c connections] [-r reconnects] [-k requests] [-P depth] [-R] [-t threads] [-p] [-b body_file] [-A] [-T connect,handshake,idle,response] [-U] [-S socket_profile] [-C crypto_threads] [-V ca_pem|embedded] [-L cipher_list] [-M] <server_ip> <port> <filename>\n", name );
+    printf( "  -c   concurrent connections\n" );
+    printf( "  -r   reconnects of every connection once it is done\n" );
+    printf( "  -k   requests sent over each kept alive connection\n" );
+    printf( "  -R   disable TLS session resumption\n" );
+    printf( "  -P   requests written back to back before the first response is read\n" );
+    printf( "  -t   worker threads, each one runs its own event loop\n" );
+    printf( "  -p   pin worker threads to cpus\n" );
+    printf( "  -b   stream this file after the request, which must announce its length\n" );
+    printf( "  -A   serve CyaSSL from per-connection arenas and size-class pools\n" );
+    printf( "  -T   per-connection deadlines in ms, 0 disables one\n" );
+    printf( "  -U   run the TLS transport on io_uring instead of epoll (USE_IO_URING builds)\n" );
+    printf( "  -S   socket options: nodelay,quickack,sndbuf=<bytes>,rcvbuf=<bytes>,fastopen\n" );
+    printf( "  -C   threads that run the handshake crypto off the event loops\n" );
+    printf( "  -V   verify the server against a PEM file or the store compiled in with TRUST_STORE\n" );
+    printf( "  -L   cipher suites to offer in order of preference, separated by ':'\n" );
+    printf( "  -M   run the workload once per suite of -L, or of every suite CyaSSL has, and compare them\n" );
+}
+
+/**
+ * \brief   Parses the command line
+ * \return  1 if successfull <0 other way
+ */
+inline static int client_options_parse( ClientOptions_t* options, const int argc, char* const* argv )
+{
+    assert( options != 0 && "Options must not be null!" );
+
+    memset( options, 0, sizeof( ClientOptions_t ) );
+
+    options->connections            = 1;
+    options->keep_alive_requests    = 1;
+    options->pipeline_depth         = 1;
+    options->resumption             = 1;
+    options->threads                = 1;
+
+    options->timeouts.ms[ DEADLINE_CONNECT ]    = 5000;
+    options->timeouts.ms[ DEADLINE_HANDSHAKE ]  = 10000;
+    options->timeouts.ms[ DEADLINE_IDLE ]       = 30000;
+    options->timeouts.ms[ DEADLINE_RESPONSE ]   = 30000;
+
+    int opt = 0;
+
+    while( ( opt = getopt( argc, argv, "c:r:k:P:Rt:pb:AT:US:C:V:L:M" ) ) != -1 )
+    {
+        switch( opt )
+        {
+            case 'c':
+                options->connections = atoi( optarg );
+                break;
+            case 'r':
+                options->reconnects = atoi( optarg );
+                break;
+            case 'k':
+                options->keep_alive_requests = atoi( optarg );
+                break;
+            case 'P':
+                options->pipeline_depth = atoi( optarg );
+                break;
+            case 'R':
+                options->resumption = 0;
+                break;
+            case 't':
+                options->threads = atoi( optarg );
+                break;
+            case 'p':
+                options->pin = 1;
+                break;
+            case 'b':
+                options->body_file = optarg;
+                break;
+            case 'A':
+                options->pooled_allocator = 1;
+                break;
+            case 'U':
+#ifdef USE_IO_URING
+                options->io_uring = 1;
+                break;
+#else
+                error_log( "io_uring support is not compiled in, rebuild with USE_IO_URING=1" );
+                return -1;
+#endif
+            case 'T':
+                if( sscanf( optarg, "%d,%d,%d,%d"
+                        , &options->timeouts.ms[ DEADLINE_CONNECT ]
+                        , &options->timeouts.ms[ DEADLINE_HANDSHAKE ]
+                        , &options->timeouts.ms[ DEADLINE_IDLE ]
+                        , &options->timeouts.ms[ DEADLINE_RESPONSE ] ) != DEADLINE_COUNT )
+                {
+                    return -1;
+                }
+                break;
+            case 'C':
+                options->crypto_threads = atoi( optarg );
+                break;
+            case 'V':
+                options->verify = optarg;
+                break;
+            case 'L':
+                options->cipher_list = optarg;
+                break;
+            case 'M':
+                options->cipher_matrix = 1;
+                break;
+            case 'S':
+                if( socket_profile_parse( &options->socket_profile, optarg ) < 0 ) { return -1; }
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    // the io_uring transport sends on its own, the SYN cannot carry data there
+    if( options->io_uring && options->socket_profile.fast_open )
+    {
+        error_log( "fastopen needs the epoll transport" );
+        return -1;
+    }
+
+    // finished crypto jobs wake up the epoll loop only
+    if( options->io_uring && options->crypto_threads > 0 )
+    {
+        error_log( "crypto threads need the epoll transport" );
+        return -1;
+    }
+
+    // a streamed body has to end before the next request can start
+    if( options->body_file != 0 && options->pipeline_depth > 1 )
+    {
+        error_log( "pipelining does not stream bodies" );
+        return -1;
+    }
+
+    if( argc - optind != 3
+        || options->connections <= 0
+        || options->reconnects < 0
+        || options->keep_alive_requests <= 0
+        || options->pipeline_depth <= 0
+        || options->threads <= 0
+        || options->crypto_threads < 0
+        || options->timeouts.ms[ DEADLINE_CONNECT ] < 0
+        || options->timeouts.ms[ DEADLINE_HANDSHAKE ] < 0
+        || options->timeouts.ms[ DEADLINE_IDLE ] < 0
+        || options->timeouts.ms[ DEADLINE_RESPONSE ] < 0 )
+    {
+        return -1;
+    }
+
+    if( options->threads > options->connections ) { options->threads = options->connections; }
+
+    options->server_ip      = argv[ optind ];
+    options->server_port    = argv[ optind + 1 ];
+    options->request_file   = argv[ optind + 2 ];
+
+    return 1;
+}
+
+/**
+ * \brief   Runs all connections on the sharded workers until every one of
+ *          them is done, the session cache of result must be freed with
+ *          session_cache_free
+ */
+inline static void client_run( const ClientOptions_t* options, ClientResult_t* result )
+{
+    assert( options != 0 && result != 0 && "Options and result must not be null!" );
+
+    const int connections       = options->connections;
+    const int threads           = options->threads;
+
+    CYASSL_CTX* cyaSSLContext   = 0;
+    ConnCtx_t*  conn_ctxs       = 0;
+    Worker_t*   workers         = 0;
+    CryptoPool_t crypto_pool;
+
+    memset( result, 0, sizeof( ClientResult_t ) );
+    conn_stats_init( &result->stats );
+
+    if( session_cache_init( &result->session_cache ) < 0 ) DIE( "Session cache initialization failed!", 0 );
+
+    // --------------------------- initialization ---------------------------------
+
+    struct sockaddr_in endpoint_addr;
+    memset( &endpoint_addr, 0, sizeof( endpoint_addr ) );
+
+    endpoint_addr.sin_family        = AF_INET;
+    endpoint_addr.sin_addr.s_addr   = inet_addr( options->server_ip );
+    endpoint_addr.sin_port          = htons( atoi( options->server_port ) );
+
+    cyaSSLContext = init_cyaSSL( options->pooled_allocator ? ALLOC_MODE_POOLED : ALLOC_MODE_SYSTEM
+        , options->cipher_list, options->verify, &result->trust_load_us );
+    if( cyaSSLContext == 0 ) DIE( "CyaSSL initialization fault...", 0 );
+
+#ifdef USE_IO_URING
+    if( options->io_uring )
+    {
+        CyaSSL_SetIORecv( cyaSSLContext, uring_transport_recv );
+        CyaSSL_SetIOSend( cyaSSLContext, uring_transport_send );
+    }
+#endif
+
+    // mapped once, every connection writes straight from the shared pages,
+    // a request built in memory is borrowed as it is
+    Payload_t payload;
+    memset( &payload, 0, sizeof( payload ) );
+
+    if( options->request_data != 0 )
+    {
+        payload.data = options->request_data;
+        payload.size = options->request_size;
+    }
+    else if( payload_map( &payload, options->request_file ) < 0 ) DIE( "Could not map given file... \n", 0 );
+
+    const char*     data        = payload.data;
+    const size_t    data_size   = payload.size;
+
+    // the body is never loaded, every connection preads its own chunks
+    BodySource_t    body;
+    int             body_fd     = -1;
+
+    if( options->body_file != 0 )
+    {
+        body_fd = open( options->body_file, O_RDONLY | O_CLOEXEC );
+        if( body_fd < 0 ) DIE( "Could not open given body file... \n", 0 );
+
+        body_source_from_fd( &body, body_fd );
+    }
+
+    if( options->crypto_threads > 0 && crypto_pool_init( &crypto_pool, options->crypto_threads ) < 0 ) DIE( "Crypto pool initialization failed!", 0 );
+
+    conn_ctxs = calloc( connections, sizeof( ConnCtx_t ) );
+    if( conn_ctxs == 0 ) DIE( "Could not allocate connection contexts!", 0 );
+
+    workers = calloc( threads, sizeof( Worker_t ) );
+    if( workers == 0 ) DIE( "Could not allocate workers!", 0 );
+
+    debug_fmt( "per-connection context: %zu bytes, %d connections: %zu bytes"
+        , sizeof( ConnCtx_t ), connections, sizeof( ConnCtx_t ) * ( size_t ) connections );
+
+    // spread the connections evenly, every worker gets a contiguous shard
+    long cpus           = sysconf( _SC_NPROCESSORS_ONLN );
+    int first           = 0;
+
+    for( int i = 0; i < threads; ++i )
+    {
+        Worker_t* worker    = &workers[ i ];
+
+        worker->id          = i;
+        worker->cpu         = options->pin && cpus > 0 ? ( int ) ( i % cpus ) : -1;
+        worker->conn_ctxs   = conn_ctxs + first;
+        worker->connections = connections / threads + ( i < connections % threads ? 1 : 0 );
+        worker->cya_ctx     = cyaSSLContext;
+        worker->data        = data;
+        worker->data_size   = data_size;
+
+        conn_stats_init( &worker->stats );
+        buffer_pool_init( &worker->buffer_pool );
+
+        first += worker->connections;
+
+        if( event_loop_init( &worker->event_loop, EVENT_LOOP_MAX_EVENTS ) < 0 ) DIE( "Event loop initialization failed!", 0 );
+
+        worker->crypto_done.event_fd = -1;
+
+        worker->dump_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if( worker->dump_fd < 0 ) DIE( "Could not create the stats dump eventfd!", 0 );
+
+        worker->dump_handle.fd = worker->dump_fd;
+
+        if( options->crypto_threads > 0 )
+        {
+            if( crypto_done_init( &worker->crypto_done ) < 0 ) DIE( "Crypto done list initialization failed!", 0 );
+
+            worker->crypto_handle.fd = worker->crypto_done.event_fd;
+        }
+
+#ifdef USE_IO_URING
+        worker->io_uring = options->io_uring;
+
+        if( worker->io_uring && uring_loop_init( &worker->uring, ( uint32_t ) worker->connections ) < 0 ) DIE( "io_uring initialization failed!", 0 );
+#endif
+
+        for( int j = 0; j < worker->connections; ++j )
+        {
+            ConnCtx_t* ctx = &worker->conn_ctxs[ j ];
+
+            ctx->conn.endpoint_addr         = endpoint_addr;
+            ctx->stats                      = &worker->stats;
+            ctx->session_cache              = options->resumption ? &result->session_cache : 0;
+            ctx->buffer_pool                = &worker->buffer_pool;
+            ctx->timer_wheel                = &worker->timer_wheel;
+            ctx->timeouts                   = &options->timeouts;
+            ctx->socket_profile             = &options->socket_profile;
+            ctx->crypto_pool                = options->crypto_threads > 0 ? &crypto_pool : 0;
+            ctx->crypto_job.done            = &worker->crypto_done;
+
+            timer_init( &ctx->deadline );
+            send_queue_init( &ctx->send_queue, CLIENT_SEND_HIGH_WATER );
+
+#ifdef USE_IO_URING
+            ctx->uring  = worker->io_uring ? &worker->uring : 0;
+            ctx->slot   = ( uint32_t ) j;
+#endif
+            ctx->body                       = body_fd >= 0 ? &body : 0;
+            ctx->reconnects_left            = options->reconnects;
+            ctx->requests_per_connection    = options->keep_alive_requests;
+            ctx->pipeline_depth             = options->pipeline_depth;
+
+            if( conn_ctx_open( ctx, cyaSSLContext ) < 0 ) DIE( "Connection initialization failed!", 0 );
+        }
+    }
+
+    // --------------------------- main non blocking event processing loops ---------------------------------
+
+    // kill -USR1 dumps the latency histograms of every worker while running
+    stats_dump_fds = calloc( threads, sizeof( int ) );
+    if( stats_dump_fds == 0 ) DIE( "Could not allocate the stats dump eventfds!", 0 );
+
+    for( int i = 0; i < threads; ++i ) { stats_dump_fds[ i ] = workers[ i ].dump_fd; }
+    stats_dump_fd_count = threads;
+
+    struct sigaction dump_action;
+    memset( &dump_action, 0, sizeof( dump_action ) );
+    dump_action.sa_handler = on_stats_dump_signal;
+    sigaction( SIGUSR1, &dump_action, 0 );
+
+    struct timespec start;
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    for( int i = 1; i < threads; ++i )
+    {
+        if( pthread_create( &workers[ i ].thread, 0, worker_run, &workers[ i ] ) != 0 ) DIE( "Could not start worker thread!", 0 );
+    }
+
+    // the main thread serves the first shard itself
+    worker_run( &workers[ 0 ] );
+
+    for( int i = 0; i < threads; ++i )
+    {
+        if( i > 0 ) { pthread_join( workers[ i ].thread, 0 ); }
+
+        result->failed += workers[ i ].failed;
+        conn_stats_merge( &result->stats, &workers[ i ].stats );
+
+        debug_fmt( "worker %d receive slabs: %lu allocated, %lu in use at peak"
+            , i, workers[ i ].buffer_pool.allocated, workers[ i ].buffer_pool.peak_in_use );
+
+        buffer_pool_free( &workers[ i ].buffer_pool );
+        event_loop_free( &workers[ i ].event_loop );
+        crypto_done_free( &workers[ i ].crypto_done );
+
+#ifdef USE_IO_URING
+        if( workers[ i ].io_uring ) { uring_loop_free( &workers[ i ].uring ); }
+#endif
+    }
+
+    // the eventfds go away with the workers, a late SIGUSR1 is ignored
+    dump_action.sa_handler = SIG_IGN;
+    sigaction( SIGUSR1, &dump_action, 0 );
+
+    stats_dump_fd_count = 0;
+
+    for( int i = 0; i < threads; ++i ) { close( workers[ i ].dump_fd ); }
+    free( stats_dump_fds ); stats_dump_fds = 0;
+
+    result->elapsed_s = elapsed_us( &start ) / 1e6;
+
+    // the crypto threads ran parts of the handshakes, their counters belong to them
+    if( options->crypto_threads > 0 )
+    {
+        crypto_pool_free( &crypto_pool );
+
+        tls_alloc_stats_merge( &result->stats.allocator, &crypto_pool.allocator );
+        result->stats.sends.calls       += crypto_pool.sends.calls;
+        result->stats.sends.syscalls    += crypto_pool.sends.syscalls;
+    }
+
+    payload_unmap( &payload );
+    if( body_fd >= 0 ) { close( body_fd ); }
+    free( workers );
+    free( conn_ctxs );
+
+    CyaSSL_CTX_free( cyaSSLContext ); cyaSSLContext = 0;
+    CyaSSL_Cleanup();
+    tls_alloc_thread_release();
+
+    assert( cyaSSLContext == 0 && "Must be null!" );
+}
+
+#endif // __TLS_CLIENT_H__
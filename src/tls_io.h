@@ -0,0 +1,533 @@
+#ifndef __TLS_IO_H__
+#define __TLS_IO_H__
+
+#include <assert.h>
+#include <stdio.h>
+#include <cyassl/ssl.h>
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "debug.h"
+#include "tls_alloc.h"
+
+/**
+ * \struct SSLCertConfig_t
+ * \brief  This structure shall hold data related via the loading function
+ *          should contain the information
+ */
+typedef struct
+{
+    const char* file;
+    const char* path;
+} SSLCertConfig_t;
+
+// handshake messages and small records are gathered up to this size before
+// they reach the socket, a record that does not fit goes out together with
+// what is already staged
+#define OUTPUT_STAGE_SIZE       4096
+
+/**
+ * \struct OutputStage_t
+ * \brief  Records CyaSSL has sent but the socket has not seen yet
+ */
+typedef struct
+{
+    size_t  size;
+    char    data[ OUTPUT_STAGE_SIZE ];
+} OutputStage_t;
+
+/**
+ * \struct SendStats_t
+ * \brief  Per-thread counters of the send callback, calls minus syscalls
+ *          is what the staging saved
+ */
+typedef struct
+{
+    unsigned long long  calls;
+    unsigned long long  syscalls;
+} SendStats_t;
+
+static __thread SendStats_t tls_io_send_stats;
+
+/**
+ * \struct SocketProfile_t
+ * \brief  Options of every connection socket, 0 keeps the kernel default
+ */
+typedef struct
+{
+    int     no_delay;
+    int     quick_ack;
+    int     send_buffer;
+    int     recv_buffer;
+    int     fast_open;
+} SocketProfile_t;
+
+/**
+ * \brief To be able to pass data between functions
+ */
+typedef struct
+{
+  int                   sock_fd;
+  struct sockaddr_in    endpoint_addr;
+  TlsArena_t            arena;
+  OutputStage_t         output;
+  int                   fast_open;
+} Conn_t;
+
+// longest sleep of an event loop while deadlines are armed
+#define EVENT_LOOP_TIMEOUT_MS   ( 3 * 60 * 1000 )
+#define EVENT_LOOP_MAX_EVENTS   64
+
+inline static uint64_t elapsed_us( const struct timespec* start )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) ( ( now.tv_sec - start->tv_sec ) * 1000000LL + ( now.tv_nsec - start->tv_nsec ) / 1000 );
+}
+
+/**
+ * \brief   Loads the certificate defined through the SSLCertConfig_t
+ * \return  1 if successfull <0 other way
+ */
+inline static int load_certificate( CYASSL_CTX* cya_ctx, const SSLCertConfig_t* cert_config )
+{
+    assert( cya_ctx != 0 && "CyaSSL context must not be null!" );
+    assert( cert_config != 0 && "CyaSSL certificate configuration must not be null!" );
+    assert( cert_config->file != 0 && "CyaSSL certificate filename must not be null!" );
+
+    // the trust anchors are loaded from a file only, there is no dir then
+    debug_fmt( "Trying to load certificate: file %s at %s dir", cert_config->file, cert_config->path != 0 ? cert_config->path : "-" );
+    int ret = CyaSSL_CTX_load_verify_locations( cya_ctx, cert_config->file, 0 );
+
+    debug_fmt( "Ret: %d", ret );
+
+    if( ret != SSL_SUCCESS )
+    {
+        return -1; //@TODO add proper cya err detection
+    }
+
+    return 1;
+}
+
+inline static int send_error_to_cbio( int errval )
+{
+    if( errval == EAGAIN || errval == EWOULDBLOCK )
+    {
+        return CYASSL_CBIO_ERR_WANT_WRITE;
+    }
+    else if( errval == EPIPE )
+    {
+        return CYASSL_CBIO_ERR_CONN_CLOSE;
+    }
+
+    return CYASSL_CBIO_ERR_GENERAL;
+}
+
+/**
+ * \brief   Sends the staged bytes followed by size bytes of extra with a
+ *          single syscall, whatever of the stage did not go out stays staged
+ * \return  bytes of extra sent, <0 with errno set if nothing was sent
+ */
+inline static ssize_t conn_output_send( Conn_t* conn, const char* extra, size_t size )
+{
+    struct iovec iov[ 2 ];
+    struct msghdr msg;
+
+    iov[ 0 ].iov_base   = conn->output.data;
+    iov[ 0 ].iov_len    = conn->output.size;
+    iov[ 1 ].iov_base   = ( void* ) extra;
+    iov[ 1 ].iov_len    = size;
+
+    memset( &msg, 0, sizeof( msg ) );
+    msg.msg_iov     = conn->output.size > 0 ? iov : iov + 1;
+    msg.msg_iovlen  = ( conn->output.size > 0 ) + ( size > 0 );
+
+    int flags = MSG_NOSIGNAL;
+
+    // the socket was never connected, the first flight rides on the SYN and
+    // without a cookie the kernel falls back to a plain handshake
+    if( conn->fast_open )
+    {
+        msg.msg_name    = &conn->endpoint_addr;
+        msg.msg_namelen = sizeof( conn->endpoint_addr );
+        flags           |= MSG_FASTOPEN;
+    }
+
+    ssize_t sent = sendmsg( conn->sock_fd, &msg, flags );
+
+    ++tls_io_send_stats.syscalls;
+
+    // client Fast Open is disabled in net.ipv4.tcp_fastopen, the socket
+    // connects the usual way and the data waits for the connection
+    if( sent < 0 && errno == EOPNOTSUPP && conn->fast_open )
+    {
+        conn->fast_open = 0;
+
+        if( connect( conn->sock_fd, ( struct sockaddr* ) &conn->endpoint_addr, sizeof( conn->endpoint_addr ) ) < 0 && errno != EINPROGRESS )
+        {
+            return -1;
+        }
+
+        msg.msg_name    = 0;
+        msg.msg_namelen = 0;
+        sent            = sendmsg( conn->sock_fd, &msg, MSG_NOSIGNAL );
+
+        ++tls_io_send_stats.syscalls;
+    }
+
+    if( sent >= 0 || errno != EINTR ) { conn->fast_open = 0; }
+
+    // the SYN is out but none of the data, it waits for the connection
+    if( sent < 0 && errno == EINPROGRESS ) { errno = EAGAIN; }
+
+    debug_fmt( "conn_output_send sent - %zd bytes", sent );
+
+    if( sent < 0 ) { return -1; }
+
+    if( ( size_t ) sent < conn->output.size )
+    {
+        memmove( conn->output.data, conn->output.data + sent, conn->output.size - sent );
+        conn->output.size -= sent;
+        return 0;
+    }
+
+    sent -= conn->output.size;
+    conn->output.size = 0;
+
+    return sent;
+}
+
+/**
+ * \brief   Pushes everything staged to the socket
+ * \return  1 if nothing is left staged, 0 if the socket is full, <0 on error
+ */
+inline static int conn_output_flush( Conn_t* conn )
+{
+    while( conn->output.size > 0 )
+    {
+        if( conn_output_send( conn, 0, 0 ) < 0 )
+        {
+            if( errno == EINTR ) { continue; }
+
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+    }
+
+    return 1;
+}
+
+inline static int myPrivateRecv( CYASSL* ssl, char* buf, int sz, void* ctx )
+{
+    ( void ) ssl;
+    int recvd   = 0;
+    int errval  = 0;
+    Conn_t* conn = ( Conn_t* ) ctx;
+
+    // CyaSSL waits for the peer now, the peer answers only what it got
+    if( conn->output.size > 0 && conn_output_flush( conn ) < 0 )
+    {
+        return send_error_to_cbio( errno );
+    }
+
+    recvd = read( conn->sock_fd, buf, sz );
+
+    debug_fmt( "myPrivateRecv received - %d bytes", recvd );
+
+    if( recvd < 0 )
+    {
+        errval = errno;
+
+        debug_fmt( "errno: %d", errval );
+
+        if( errval == EAGAIN || errval == EWOULDBLOCK )
+        {
+            return CYASSL_CBIO_ERR_WANT_READ;
+        }
+        else
+        {
+            return CYASSL_CBIO_ERR_GENERAL;
+        }
+    }
+    else if( recvd == 0 )
+    {
+        return CYASSL_CBIO_ERR_CONN_CLOSE;
+    }
+
+    return recvd;
+}
+
+inline static int myPrivateSend( CYASSL* ssl, char* buf, int sz, void* ctx )
+{
+    ( void ) ssl;
+
+    Conn_t* conn    = ( Conn_t* ) ctx;
+    size_t size     = ( size_t ) sz;
+
+    ++tls_io_send_stats.calls;
+
+    // records are only staged while they fit, the stage is flushed before
+    // CyaSSL reads and before the connection waits
+    if( conn->output.size + size <= OUTPUT_STAGE_SIZE )
+    {
+        memcpy( conn->output.data + conn->output.size, buf, size );
+        conn->output.size += size;
+        return sz;
+    }
+
+    ssize_t sent = conn_output_send( conn, buf, size );
+
+    if( sent < 0 )
+    {
+        debug_fmt( "errno: %d", errno );
+
+        return send_error_to_cbio( errno );
+    }
+
+    // the tail of the record is staged when it fits so CyaSSL can go on
+    if( conn->output.size + ( size - sent ) <= OUTPUT_STAGE_SIZE )
+    {
+        memcpy( conn->output.data + conn->output.size, buf + sent, size - sent );
+        conn->output.size += size - sent;
+        return sz;
+    }
+
+    return sent > 0 ? ( int ) sent : CYASSL_CBIO_ERR_WANT_WRITE;
+}
+
+inline static CYASSL* create_cyassl_object( CYASSL_CTX* cya_ctx, Conn_t* conn )
+{
+    assert( cya_ctx != 0 && "CyaSSL context must not be null!" );
+    assert( conn != 0 && "Conn ptr must not be null!" );
+
+    CYASSL* xCyaSSL_Object = 0;
+
+    // the connection state lives in the arena of the connection
+    tls_arena_enter( &conn->arena );
+    xCyaSSL_Object = CyaSSL_new( cya_ctx );
+    tls_arena_leave();
+
+    if( xCyaSSL_Object != NULL )
+    {
+        /* Associate the created CyaSSL object with the connected socket. */
+        if( CyaSSL_set_fd( xCyaSSL_Object, conn->sock_fd ) != SSL_SUCCESS )
+        {
+            CyaSSL_free( xCyaSSL_Object );
+            return 0;
+        }
+
+        // the callbacks need the output stage next to the socket
+        conn->output.size = 0;
+        CyaSSL_SetIOReadCtx( xCyaSSL_Object, conn );
+        CyaSSL_SetIOWriteCtx( xCyaSSL_Object, conn );
+
+        return xCyaSSL_Object;
+    }
+
+    return 0;
+}
+
+inline static void DIE( const char msg[], CYASSL* cyaSSLObject )
+{
+    char* err_buffer        = 0;
+    char buffer[ 256 ]      = { '\0' };
+
+    int err = errno;
+
+    error_fmt( "exiting: %s", msg );
+    err_buffer = strerror( err );
+    error_fmt( "errno: %s", err_buffer );
+
+    if( cyaSSLObject != 0 )
+    {
+        int cyaErr = CyaSSL_get_error( cyaSSLObject, 0 );
+        CyaSSL_ERR_error_string( cyaErr, buffer );
+        error_fmt( "CyaSSLErr: %d -> %s", cyaErr, buffer );
+    }
+
+    exit( -1 );
+}
+
+inline static CYASSL* closeSSL( CYASSL* cyaSSLObject, Conn_t* conn )
+{
+    // last chance for staged records, the socket is not waited for
+    conn_output_flush( conn );
+
+    if( shutdown( conn->sock_fd, SHUT_RDWR ) < 0 )
+    {
+        debug_log( "Shutdown failed..." );
+    }
+
+    close( conn->sock_fd );
+
+    CyaSSL_free( cyaSSLObject );
+
+    // whatever CyaSSL kept in the arena goes away at once
+    tls_arena_release( &conn->arena );
+
+    return 0;
+}
+
+inline static int create_non_blocking_socket()
+{
+    int socket_fd = socket( PF_INET, SOCK_STREAM, IPPROTO_TCP );
+    if( socket_fd <= 0 ) return -1;
+
+    int flags = fcntl( socket_fd, F_GETFL, 0 );
+    if( flags == -1 ) return -1;
+
+    if( fcntl( socket_fd, F_SETFL, flags | O_NONBLOCK ) == -1 ) return -1;
+
+    return socket_fd;
+}
+
+/**
+ * \brief   Parses a comma separated profile like "nodelay,quickack,
+ *          sndbuf=262144,rcvbuf=262144,fastopen"
+ * \return  1 if successfull <0 other way
+ */
+inline static int socket_profile_parse( SocketProfile_t* profile, const char* text )
+{
+    assert( profile != 0 && text != 0 && "Profile and text must not be null!" );
+
+    while( *text != '\0' )
+    {
+        size_t length   = strcspn( text, "," );
+        int value       = 0;
+
+        if( length == 7 && strncmp( text, "nodelay", length ) == 0 )            { profile->no_delay = 1; }
+        else if( length == 8 && strncmp( text, "quickack", length ) == 0 )      { profile->quick_ack = 1; }
+        else if( length == 8 && strncmp( text, "fastopen", length ) == 0 )      { profile->fast_open = 1; }
+        else if( sscanf( text, "sndbuf=%d", &value ) == 1 && value > 0 )        { profile->send_buffer = value; }
+        else if( sscanf( text, "rcvbuf=%d", &value ) == 1 && value > 0 )        { profile->recv_buffer = value; }
+        else
+        {
+            error_fmt( "unknown socket option: %.*s", ( int ) length, text );
+            return -1;
+        }
+
+        text += length;
+        if( *text == ',' ) { ++text; }
+    }
+
+    return 1;
+}
+
+/**
+ * \brief   Sets the options of the profile on a fresh socket, TCP_QUICKACK
+ *          is not permanent, the kernel may go back to delayed ACKs later
+ * \return  1 if successfull <0 other way
+ */
+inline static int apply_socket_profile( int fd, const SocketProfile_t* profile )
+{
+    assert( profile != 0 && "Profile must not be null!" );
+
+    int on = 1;
+
+    if( profile->no_delay && setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) ) < 0 )                   { return -1; }
+    if( profile->quick_ack && setsockopt( fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof( on ) ) < 0 )                 { return -1; }
+    if( profile->send_buffer > 0
+        && setsockopt( fd, SOL_SOCKET, SO_SNDBUF, &profile->send_buffer, sizeof( profile->send_buffer ) ) < 0 )   { return -1; }
+    if( profile->recv_buffer > 0
+        && setsockopt( fd, SOL_SOCKET, SO_RCVBUF, &profile->recv_buffer, sizeof( profile->recv_buffer ) ) < 0 )   { return -1; }
+
+    return 1;
+}
+
+inline static void set_cyassl_flags( CYASSL* cya_obj )
+{
+    assert( cya_obj != 0 && "CyaSSL object must not be null!" );
+
+    CyaSSL_set_using_nonblock( cya_obj, 1 );
+}
+
+/**
+ * \brief   Starts connecting the socket to the endpoint, with fast_open there
+ *          is no connect, the send callback puts the first flight into the SYN
+ * \return  1 if the handshake can start, 0 if the socket has to become
+ *          writable first, <0 on error with errno set
+ */
+inline static int conn_connect_start( Conn_t* conn, int fast_open )
+{
+    assert( conn != 0 && "Conn ptr must not be null!" );
+
+    if( fast_open )
+    {
+        conn->fast_open = 1;
+        return 1;
+    }
+
+    if( connect( conn->sock_fd, ( struct sockaddr* ) &conn->endpoint_addr, sizeof( conn->endpoint_addr ) ) == 0 ) { return 1; }
+
+    return errno == EINPROGRESS ? 0 : -1;
+}
+
+/**
+ * \brief   Outcome of a connect the socket became writable for
+ * \return  1 if connected <0 other way with errno set
+ */
+inline static int conn_connect_finish( Conn_t* conn )
+{
+    assert( conn != 0 && "Conn ptr must not be null!" );
+
+    int valopt      = 0;
+    socklen_t lon   = sizeof( int );
+
+    if( getsockopt( conn->sock_fd, SOL_SOCKET, SO_ERROR, ( void* )( &valopt ), &lon ) < 0 ) { return -1; }
+
+    if( valopt )
+    {
+        errno = valopt;
+        return -1;
+    }
+
+    return 1;
+}
+
+/**
+ * \brief   One step of the client handshake, what CyaSSL allocates for the
+ *          SSL object on the way lives in the arena of the connection
+ * \return  SSL_SUCCESS once done, SSL_ERROR_WANT_READ or SSL_ERROR_WANT_WRITE
+ *          to be called again, any other CyaSSL error ends the handshake
+ */
+inline static int tls_connect_step( CYASSL* cya_obj, TlsArena_t* arena )
+{
+    assert( cya_obj != 0 && "CyaSSL object must not be null!" );
+
+    tls_arena_enter( arena );
+    int ret = CyaSSL_connect( cya_obj );
+    tls_arena_leave();
+
+    return ret <= 0 ? CyaSSL_get_error( cya_obj, ret ) : ret;
+}
+
+inline static void pin_thread( int id, int cpu )
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( cpu, &cpu_set );
+
+    int ret = pthread_setaffinity_np( pthread_self(), sizeof( cpu_set ), &cpu_set );
+
+    if( ret != 0 )
+    {
+        error_fmt( "worker %d could not be pinned to cpu %d: %s", id, cpu, strerror( ret ) );
+    }
+}
+
+#endif // __TLS_IO_H__
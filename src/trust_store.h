@@ -0,0 +1,53 @@
+#ifndef __TRUST_STORE_H__
+#define __TRUST_STORE_H__
+
+#include <assert.h>
+#include <cyassl/ssl.h>
+
+#include "debug.h"
+
+/**
+ * \struct TrustAnchor_t
+ * \brief  DER encoded certificate compiled into the binary
+ */
+typedef struct
+{
+    const unsigned char*    der;
+    long                    size;
+} TrustAnchor_t;
+
+// built from the PEM bundle given as TRUST_STORE to make
+#ifdef USE_TRUST_STORE
+#include "trust_store_data.h"
+#endif
+
+/**
+ * \brief   Loads the certificates embedded at build time into the context,
+ *          nothing is read from disk and no PEM is decoded
+ * \return  number of certificates loaded if successfull <0 other way
+ */
+inline static int load_trust_store( CYASSL_CTX* cya_ctx )
+{
+    assert( cya_ctx != 0 && "CyaSSL context must not be null!" );
+
+#ifdef USE_TRUST_STORE
+    const int count = ( int ) ( sizeof( trust_store_anchors ) / sizeof( trust_store_anchors[ 0 ] ) );
+
+    for( int i = 0; i < count; ++i )
+    {
+        if( CyaSSL_CTX_load_verify_buffer( cya_ctx, trust_store_anchors[ i ].der, trust_store_anchors[ i ].size, SSL_FILETYPE_ASN1 ) != SSL_SUCCESS )
+        {
+            error_fmt( "embedded certificate %d was rejected", i );
+            return -1;
+        }
+    }
+
+    return count;
+#else
+    ( void ) cya_ctx;
+    error_log( "no trust store compiled in, rebuild with TRUST_STORE=<pem bundle>" );
+    return -1;
+#endif
+}
+
+#endif // __TRUST_STORE_H__
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Turns a PEM bundle into DER certificates embedded as C arrays, the
+# Makefile runs it when TRUST_STORE is set, the output goes to stdout
+set -e
+
+pem="$1"
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+[ -r "$pem" ] || { echo "cannot read $pem" >&2; exit 1; }
+
+# one file per certificate, whatever is between them is dropped
+awk -v dir="$tmp" '
+    /-----BEGIN CERTIFICATE-----/   { n++; out = sprintf( "%s/%04d.pem", dir, n ) }
+    out != ""                       { print > out }
+    /-----END CERTIFICATE-----/     { close( out ); out = "" }
+' "$pem"
+
+set -- "$tmp"/*.pem
+[ -f "$1" ] || { echo "no certificate in $pem" >&2; exit 1; }
+
+echo "// generated from $pem by make, do not edit"
+echo
+
+count=0
+for cert in "$@"; do
+    openssl x509 -in "$cert" -outform der -out "$tmp/cert.der"
+
+    echo "// $(openssl x509 -in "$cert" -noout -subject)"
+    echo "static const unsigned char trust_store_cert_$count[] ="
+    echo "{"
+    od -An -v -tx1 "$tmp/cert.der" | sed -e 's/ *\([0-9a-f][0-9a-f]\)/ 0x\1,/g' -e 's/^/   /'
+    echo "};"
+    echo
+
+    count=$((count + 1))
+done
+
+echo "static const TrustAnchor_t trust_store_anchors[] ="
+echo "{"
+i=0
+while [ $i -lt $count ]; do
+    echo "    { trust_store_cert_$i, sizeof( trust_store_cert_$i ) },"
+    i=$((i + 1))
+done
+echo "};"
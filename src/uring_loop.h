@@ -0,0 +1,397 @@
+#ifndef __URING_LOOP_H__
+#define __URING_LOOP_H__
+
+#ifdef USE_IO_URING
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <liburing.h>
+#include <cyassl/ssl.h>
+
+#include "debug.h"
+#include "event_loop.h"
+
+// one full TLS record plus its header, MAC and padding
+#define URING_BUFFER_SIZE       ( 16384 + 2048 )
+
+// user_data of every submission: slot << 32 | generation << 8 | operation
+#define URING_OP_RECV           1
+#define URING_OP_SEND           2
+#define URING_OP_POLL           3
+
+// user_data of the poll on the wake fd, beyond any slot
+#define URING_WAKE_USER_DATA    UINT64_MAX
+
+/**
+ * \struct UringTransport_t
+ * \brief  What CyaSSL reads from and writes to when the connection runs on
+ *          io_uring, the callbacks only move bytes between CyaSSL and these
+ *          buffers, the loop submits the actual I/O for all connections at once
+ */
+typedef struct
+{
+    int         fd;
+    uint32_t    slot;
+    uint32_t    generation;
+    void*       owner;
+    char*       recv_buffer;
+    size_t      recv_start;
+    size_t      recv_end;
+    int         recv_pending;
+    int         recv_result;
+    char*       send_buffer;
+    size_t      send_size;
+    size_t      send_done;
+    int         send_pending;
+    int         send_result;
+    int         poll_pending;
+    struct uring_loop* loop;
+} UringTransport_t;
+
+/**
+ * \struct UringLoop_t
+ * \brief  One ring per worker, the receive buffers of all its connections
+ *          are registered with the kernel once so reads complete into them
+ *          without any per-operation mapping
+ */
+typedef struct uring_loop
+{
+    struct io_uring     ring;
+    UringTransport_t**  transports;
+    char*               recv_buffers;
+    char*               send_buffers;
+    uint32_t            slots;
+    int                 fixed_buffers;
+    int                 woken;
+    unsigned long long  waits;
+    unsigned long long  completions;
+} UringLoop_t;
+
+inline static uint64_t uring_user_data( const UringTransport_t* transport, int op )
+{
+    return ( ( uint64_t ) transport->slot << 32 ) | ( ( uint64_t ) ( transport->generation & 0xffffff ) << 8 ) | ( uint64_t ) op;
+}
+
+/**
+ * \brief   Next free submission entry, a full queue is handed to the kernel
+ *          first, that is the only place a submission costs a syscall of
+ *          its own
+ */
+inline static struct io_uring_sqe* uring_loop_sqe( UringLoop_t* loop )
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe( &loop->ring );
+
+    if( sqe == 0 )
+    {
+        io_uring_submit( &loop->ring );
+        sqe = io_uring_get_sqe( &loop->ring );
+    }
+
+    return sqe;
+}
+
+/**
+ * \brief   Creates the ring and the per-connection buffers of slots connections
+ * \return  1 if successfull <0 other way
+ */
+inline static int uring_loop_init( UringLoop_t* loop, uint32_t slots )
+{
+    assert( loop != 0 && slots > 0 && "Loop must not be null and needs at least one slot!" );
+
+    memset( loop, 0, sizeof( UringLoop_t ) );
+
+    // every connection has at most a receive, a send and a poll in flight
+    unsigned entries = slots * 3 < 4096 ? slots * 3 : 4096;
+
+    if( io_uring_queue_init( entries, &loop->ring, 0 ) < 0 ) { return -1; }
+
+    loop->slots         = slots;
+    loop->transports    = calloc( slots, sizeof( UringTransport_t* ) );
+    loop->recv_buffers  = malloc( ( size_t ) slots * URING_BUFFER_SIZE );
+    loop->send_buffers  = malloc( ( size_t ) slots * URING_BUFFER_SIZE );
+
+    if( loop->transports == 0 || loop->recv_buffers == 0 || loop->send_buffers == 0 )
+    {
+        free( loop->transports );
+        free( loop->recv_buffers );
+        free( loop->send_buffers );
+        io_uring_queue_exit( &loop->ring );
+        return -1;
+    }
+
+    struct iovec iov;
+    iov.iov_base    = loop->recv_buffers;
+    iov.iov_len     = ( size_t ) slots * URING_BUFFER_SIZE;
+
+    // pinning may hit the memlock limit, plain receives work without it
+    loop->fixed_buffers = io_uring_register_buffers( &loop->ring, &iov, 1 ) == 0;
+
+    if( !loop->fixed_buffers )
+    {
+        info_log( "Could not register the receive buffers, falling back to plain receives" );
+    }
+
+    return 1;
+}
+
+inline static void uring_loop_free( UringLoop_t* loop )
+{
+    assert( loop != 0 && "Loop must not be null!" );
+
+    io_uring_queue_exit( &loop->ring );
+    free( loop->transports );
+    free( loop->recv_buffers );
+    free( loop->send_buffers );
+
+    memset( loop, 0, sizeof( UringLoop_t ) );
+}
+
+/**
+ * \brief   Binds a freshly connected socket to its slot, completions of an
+ *          earlier connection of the same slot are ignored from now on
+ */
+inline static void uring_transport_open( UringTransport_t* transport, UringLoop_t* loop, uint32_t slot, int fd, void* owner )
+{
+    assert( transport != 0 && loop != 0 && slot < loop->slots && "Transport must fit into the loop!" );
+
+    uint32_t generation = transport->generation + 1;
+
+    memset( transport, 0, sizeof( UringTransport_t ) );
+
+    transport->fd           = fd;
+    transport->slot         = slot;
+    transport->generation   = generation;
+    transport->owner        = owner;
+    transport->loop         = loop;
+    transport->recv_buffer  = loop->recv_buffers + ( size_t ) slot * URING_BUFFER_SIZE;
+    transport->send_buffer  = loop->send_buffers + ( size_t ) slot * URING_BUFFER_SIZE;
+
+    loop->transports[ slot ] = transport;
+}
+
+/**
+ * \brief   Forgets every operation in flight, they end once the socket is
+ *          shut down and are dropped by the generation check
+ */
+inline static void uring_transport_close( UringTransport_t* transport )
+{
+    ++transport->generation;
+
+    transport->recv_pending = 0;
+    transport->send_pending = 0;
+    transport->poll_pending = 0;
+}
+
+inline static void uring_transport_queue_recv( UringTransport_t* transport )
+{
+    struct io_uring_sqe* sqe = uring_loop_sqe( transport->loop );
+    if( sqe == 0 ) { transport->recv_result = CYASSL_CBIO_ERR_GENERAL; return; }
+
+    if( transport->loop->fixed_buffers )
+    {
+        io_uring_prep_read_fixed( sqe, transport->fd, transport->recv_buffer, URING_BUFFER_SIZE, 0, 0 );
+    }
+    else
+    {
+        io_uring_prep_recv( sqe, transport->fd, transport->recv_buffer, URING_BUFFER_SIZE, 0 );
+    }
+
+    io_uring_sqe_set_data64( sqe, uring_user_data( transport, URING_OP_RECV ) );
+    transport->recv_pending = 1;
+}
+
+inline static void uring_transport_queue_send( UringTransport_t* transport )
+{
+    struct io_uring_sqe* sqe = uring_loop_sqe( transport->loop );
+    if( sqe == 0 ) { transport->send_result = CYASSL_CBIO_ERR_GENERAL; return; }
+
+    io_uring_prep_send( sqe, transport->fd, transport->send_buffer + transport->send_done, transport->send_size - transport->send_done, MSG_NOSIGNAL );
+    io_uring_sqe_set_data64( sqe, uring_user_data( transport, URING_OP_SEND ) );
+    transport->send_pending = 1;
+}
+
+/**
+ * \brief   Makes sure the coroutine that just yielded is woken up again,
+ *          a pending receive or send does that already, otherwise readiness
+ *          of the socket is polled for, e.g. while connecting
+ */
+inline static void uring_transport_watch( UringTransport_t* transport, wanted_event_t wanted_event )
+{
+    if( transport->recv_pending || transport->send_pending || transport->poll_pending ) { return; }
+
+    struct io_uring_sqe* sqe = uring_loop_sqe( transport->loop );
+    if( sqe == 0 ) { return; }
+
+    io_uring_prep_poll_add( sqe, transport->fd, wanted_event == WANT_READ ? POLLIN : POLLOUT );
+    io_uring_sqe_set_data64( sqe, uring_user_data( transport, URING_OP_POLL ) );
+    transport->poll_pending = 1;
+}
+
+/**
+ * \brief   Polls an fd that is not a connection, e.g. an eventfd written from
+ *          a signal handler, once it is readable the loop sets woken and the
+ *          caller has to watch it again
+ */
+inline static void uring_loop_watch_wake( UringLoop_t* loop, int fd )
+{
+    struct io_uring_sqe* sqe = uring_loop_sqe( loop );
+    if( sqe == 0 ) { return; }
+
+    io_uring_prep_poll_add( sqe, fd, POLLIN );
+    io_uring_sqe_set_data64( sqe, URING_WAKE_USER_DATA );
+}
+
+/**
+ * \brief   CyaSSL receive callback, served from the completed receive, an
+ *          empty buffer queues the next one
+ */
+inline static int uring_transport_recv( CYASSL* ssl, char* buf, int sz, void* ctx )
+{
+    ( void ) ssl;
+
+    UringTransport_t* transport = ( UringTransport_t* ) ctx;
+
+    if( transport->recv_start < transport->recv_end )
+    {
+        size_t size = transport->recv_end - transport->recv_start;
+        if( size > ( size_t ) sz ) { size = ( size_t ) sz; }
+
+        memcpy( buf, transport->recv_buffer + transport->recv_start, size );
+        transport->recv_start += size;
+
+        return ( int ) size;
+    }
+
+    if( transport->recv_result != 0 ) { return transport->recv_result; }
+
+    if( !transport->recv_pending ) { uring_transport_queue_recv( transport ); }
+
+    return CYASSL_CBIO_ERR_WANT_READ;
+}
+
+/**
+ * \brief   CyaSSL send callback, the bytes are staged and sent by the loop,
+ *          CyaSSL is asked to retry while a previous send is in flight
+ */
+inline static int uring_transport_send( CYASSL* ssl, char* buf, int sz, void* ctx )
+{
+    ( void ) ssl;
+
+    UringTransport_t* transport = ( UringTransport_t* ) ctx;
+
+    if( transport->send_result != 0 )   { return transport->send_result; }
+    if( transport->send_pending )       { return CYASSL_CBIO_ERR_WANT_WRITE; }
+
+    size_t size = ( size_t ) sz < URING_BUFFER_SIZE ? ( size_t ) sz : URING_BUFFER_SIZE;
+
+    memcpy( transport->send_buffer, buf, size );
+    transport->send_size    = size;
+    transport->send_done    = 0;
+
+    uring_transport_queue_send( transport );
+
+    return ( int ) size;
+}
+
+/**
+ * \brief   Submits everything the callbacks queued and waits for completions
+ *          in the same io_uring_enter, it covers all connections of the
+ *          worker, a negative timeout waits for as long as it takes, waiting
+ *          alone would leave the queued submissions with the kernel unseen
+ * \return  0 if completions are ready, -ETIME on timeout, <0 on error
+ */
+inline static int uring_loop_wait( UringLoop_t* loop, int timeout_ms )
+{
+    struct io_uring_cqe* cqe = 0;
+    struct __kernel_timespec ts;
+
+    ts.tv_sec   = timeout_ms / 1000;
+    ts.tv_nsec  = ( long long ) ( timeout_ms % 1000 ) * 1000000;
+
+    ++loop->waits;
+
+    int ret = io_uring_submit_and_wait_timeout( &loop->ring, &cqe, 1, timeout_ms >= 0 ? &ts : 0, 0 );
+
+    // depending on the liburing version success is 0 or the submitted count
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * \brief   Applies the next completion to its transport
+ * \return  owner of the transport to resume, 0 when no completion is left
+ */
+inline static void* uring_loop_next( UringLoop_t* loop )
+{
+    struct io_uring_cqe* cqe = 0;
+
+    while( io_uring_peek_cqe( &loop->ring, &cqe ) == 0 )
+    {
+        uint64_t user_data  = io_uring_cqe_get_data64( cqe );
+        int result          = cqe->res;
+
+        io_uring_cqe_seen( &loop->ring, cqe );
+        ++loop->completions;
+
+        if( user_data == URING_WAKE_USER_DATA )
+        {
+            loop->woken = 1;
+            continue;
+        }
+
+        uint32_t slot               = ( uint32_t ) ( user_data >> 32 );
+        UringTransport_t* transport = slot < loop->slots ? loop->transports[ slot ] : 0;
+
+        // left over from a connection that is already closed
+        if( transport == 0 || ( ( user_data >> 8 ) & 0xffffff ) != ( transport->generation & 0xffffff ) ) { continue; }
+
+        switch( user_data & 0xff )
+        {
+            case URING_OP_RECV:
+                transport->recv_pending = 0;
+                transport->recv_start   = 0;
+                transport->recv_end     = result > 0 ? ( size_t ) result : 0;
+
+                if( result == 0 )       { transport->recv_result = CYASSL_CBIO_ERR_CONN_CLOSE; }
+                else if( result < 0 )   { transport->recv_result = result == -ECONNRESET ? CYASSL_CBIO_ERR_CONN_RST : CYASSL_CBIO_ERR_GENERAL; }
+                break;
+
+            case URING_OP_SEND:
+                transport->send_pending = 0;
+
+                if( result < 0 )
+                {
+                    transport->send_result = result == -ECONNRESET || result == -EPIPE ? CYASSL_CBIO_ERR_CONN_RST : CYASSL_CBIO_ERR_GENERAL;
+                }
+                else if( ( transport->send_done += ( size_t ) result ) < transport->send_size )
+                {
+                    // short send, the rest goes out before anything else
+                    uring_transport_queue_send( transport );
+                    continue;
+                }
+                break;
+
+            case URING_OP_POLL:
+                transport->poll_pending = 0;
+                break;
+
+            default:
+                continue;
+        }
+
+        return transport->owner;
+    }
+
+    return 0;
+}
+
+#endif // USE_IO_URING
+
+#endif // __URING_LOOP_H__
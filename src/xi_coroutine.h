@@ -25,6 +25,28 @@ extern "C" {
 #define END_CORO()\
     };
 
+/**
+ * Re-entrant variants, the resume point lives in the `cs` member of a
+ * caller owned context together with every local that has to survive a
+ * yield, so any number of instances can be interleaved on one thread.
+ */
+#define CORO_CTX_STATE( ctx ) ( ( ctx )->cs )
+
+#define CORO_CTX_INIT( ctx )\
+    CORO_CTX_STATE( ctx ) = 0
+
+#define BEGIN_CORO_CTX( ctx )\
+    BEGIN_CORO( CORO_CTX_STATE( ctx ) )
+
+#define YIELD_CTX( ctx, ret )\
+    YIELD( CORO_CTX_STATE( ctx ), ret )
+
+#define EXIT_CTX( ctx, ret )\
+    EXIT( CORO_CTX_STATE( ctx ), ret )
+
+#define RESTART_CTX( ctx, ret )\
+    RESTART( CORO_CTX_STATE( ctx ), ret )
+
 #ifdef __cplusplus
 }
 #endif